@@ -0,0 +1,172 @@
+/*
+SPDX-FileCopyrightText: 2026 agent <agent@local>
+
+SPDX-License-Identifier: GPL-2.0-or-later
+*/
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <ctime>
+#include <mutex>
+#include <string>
+#include <sys/resource.h>
+#include <vector>
+
+namespace theseus_ship::bench
+{
+
+using clock = std::chrono::steady_clock;
+
+inline double to_ms(clock::duration duration)
+{
+    return std::chrono::duration<double, std::milli>(duration).count();
+}
+
+/**
+ * Collects samples in milliseconds from multiple threads.
+ */
+class samples
+{
+public:
+    void add(double value)
+    {
+        std::lock_guard lock(mutex);
+        values.push_back(value);
+    }
+
+    void add(std::vector<double> const& batch)
+    {
+        std::lock_guard lock(mutex);
+        values.insert(values.end(), batch.begin(), batch.end());
+    }
+
+    double mean()
+    {
+        std::lock_guard lock(mutex);
+        if (values.empty()) {
+            return 0;
+        }
+
+        double sum = 0;
+        for (auto value : values) {
+            sum += value;
+        }
+        return sum / values.size();
+    }
+
+    /**
+     * Prints count, mean and percentiles of the samples on a single line.
+     */
+    void print(std::string const& name)
+    {
+        std::lock_guard lock(mutex);
+
+        if (values.empty()) {
+            printf("%-28s no samples\n", name.c_str());
+            return;
+        }
+
+        std::sort(values.begin(), values.end());
+
+        auto percentile = [this](double pct) {
+            auto const index = static_cast<size_t>(pct / 100. * (values.size() - 1) + .5);
+            return values.at(std::min(index, values.size() - 1));
+        };
+
+        double sum = 0;
+        for (auto value : values) {
+            sum += value;
+        }
+
+        printf("%-28s n=%-7zu mean=%8.3f p50=%8.3f p90=%8.3f p99=%8.3f max=%8.3f ms\n",
+               name.c_str(),
+               values.size(),
+               sum / values.size(),
+               percentile(50),
+               percentile(90),
+               percentile(99),
+               values.back());
+    }
+
+private:
+    std::mutex mutex;
+    std::vector<double> values;
+};
+
+/**
+ * Measures CPU time of the compositor between construction and stop().
+ *
+ * The synthetic clients run in the same process. Their threads report the CPU time they used
+ * through add_client_thread() and it is subtracted from the process time, so only the compositor
+ * threads are accounted for. The time of the constructing thread, the compositor main thread, is
+ * reported separately.
+ */
+class cpu_usage
+{
+public:
+    cpu_usage()
+        : wall_start{clock::now()}
+        , process_start{process_time()}
+        , thread_start{thread_time()}
+    {
+    }
+
+    /**
+     * To be called by each client thread once it is done.
+     */
+    void add_client_thread()
+    {
+        client_time.fetch_add(thread_time());
+    }
+
+    /**
+     * Ends the measurement. Must be called from the constructing thread.
+     */
+    void stop()
+    {
+        wall = to_ms(clock::now() - wall_start);
+        process = process_time() - process_start;
+        thread = thread_time() - thread_start;
+    }
+
+    void print(std::string const& thread_name) const
+    {
+        if (wall <= 0) {
+            return;
+        }
+
+        auto const compositor = std::max(0., process - client_time.load());
+        printf("%-28s %6.1f %%\n", "CPU compositor threads", compositor / wall * 100);
+        printf("%-28s %6.1f %%\n", ("CPU " + thread_name).c_str(), thread / wall * 100);
+    }
+
+private:
+    static double process_time()
+    {
+        rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        auto to_ms = [](timeval const& val) { return val.tv_sec * 1000. + val.tv_usec / 1000.; };
+        return to_ms(usage.ru_utime) + to_ms(usage.ru_stime);
+    }
+
+    static double thread_time()
+    {
+        timespec spec;
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &spec);
+        return spec.tv_sec * 1000. + spec.tv_nsec / 1000000.;
+    }
+
+    clock::time_point wall_start;
+    double process_start;
+    double thread_start;
+    std::atomic<double> client_time{0};
+
+    double wall{0};
+    double process{0};
+    double thread{0};
+};
+
+}
@@ -0,0 +1,561 @@
+/*
+SPDX-FileCopyrightText: 2026 agent <agent@local>
+
+SPDX-License-Identifier: GPL-2.0-or-later
+*/
+#include "bench.h"
+#include "main.h"
+#include "main_wayland.h"
+
+#include "wayland-presentation-time-client-protocol.h"
+#include "wayland-xdg-shell-client-protocol.h"
+
+#include <como/base/wayland/app_singleton.h>
+
+#include <QCommandLineParser>
+#include <QTimer>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <csignal>
+#include <cstring>
+#include <iostream>
+#include <poll.h>
+#include <sys/mman.h>
+#include <thread>
+#include <unistd.h>
+#include <wayland-client.h>
+
+namespace
+{
+
+using namespace theseus_ship;
+
+struct bench_config {
+    int clients{8};
+    int rate{60};
+    int duration{10};
+    int width{256};
+    int height{256};
+};
+
+struct bench_results {
+    bench::samples frame_intervals;
+    bench::samples commit_to_present;
+    bench::samples frame_callbacks;
+    std::atomic<int> discarded{0};
+    std::atomic<int> skipped{0};
+    std::atomic<int> failed{0};
+};
+
+double clock_ms(clockid_t clock)
+{
+    timespec spec;
+    clock_gettime(clock, &spec);
+    return spec.tv_sec * 1000. + spec.tv_nsec / 1000000.;
+}
+
+double monotonic_ms()
+{
+    return clock_ms(CLOCK_MONOTONIC);
+}
+
+/**
+ * A synthetic Wayland client that maps one toplevel and commits shm buffers at a fixed rate.
+ *
+ * Each client runs on its own thread with its own connection.
+ */
+class client
+{
+public:
+    client(std::string socket, bench_config const& config, bench_results& results)
+        : socket{std::move(socket)}
+        , config{config}
+        , results{results}
+    {
+    }
+
+    ~client()
+    {
+        for (auto buffer : buffers) {
+            if (buffer) {
+                wl_buffer_destroy(buffer);
+            }
+        }
+        if (toplevel) {
+            xdg_toplevel_destroy(toplevel);
+        }
+        if (xsurface) {
+            xdg_surface_destroy(xsurface);
+        }
+        if (surface) {
+            wl_surface_destroy(surface);
+        }
+        if (presentation) {
+            wp_presentation_destroy(presentation);
+        }
+        if (wm_base) {
+            xdg_wm_base_destroy(wm_base);
+        }
+        if (shm) {
+            wl_shm_destroy(shm);
+        }
+        if (compositor) {
+            wl_compositor_destroy(compositor);
+        }
+        if (registry) {
+            wl_registry_destroy(registry);
+        }
+        if (display) {
+            wl_display_disconnect(display);
+        }
+        if (shm_data != MAP_FAILED) {
+            munmap(shm_data, shm_size);
+        }
+    }
+
+    void run()
+    {
+        if (!setup()) {
+            results.failed++;
+            return;
+        }
+
+        auto const interval = 1000. / config.rate;
+        auto const end = monotonic_ms() + config.duration * 1000.;
+        auto next = monotonic_ms();
+
+        while (true) {
+            auto now = monotonic_ms();
+            if (now >= end) {
+                break;
+            }
+            if (now >= next) {
+                commit_frame();
+                next += interval;
+            }
+
+            if (!dispatch(std::max(0, static_cast<int>(next - monotonic_ms())))) {
+                results.failed++;
+                break;
+            }
+        }
+
+        results.frame_intervals.add(intervals);
+        results.commit_to_present.add(present_latencies);
+        results.frame_callbacks.add(callback_latencies);
+    }
+
+private:
+    struct pending_frame {
+        client* self;
+        double commit_time;
+    };
+
+    bool setup()
+    {
+        display = wl_display_connect(socket.c_str());
+        if (!display) {
+            std::cerr << "Client failed to connect to " << socket << std::endl;
+            return false;
+        }
+
+        static wp_presentation_listener const presentation_listener = {
+            .clock_id =
+                [](void* data, wp_presentation*, uint32_t clock) {
+                    static_cast<client*>(data)->presentation_clock = static_cast<clockid_t>(clock);
+                },
+        };
+
+        static wl_registry_listener const registry_listener = {
+            .global =
+                [](void* data, wl_registry* registry, uint32_t name, char const* iface, uint32_t) {
+                    auto self = static_cast<client*>(data);
+                    if (strcmp(iface, wl_compositor_interface.name) == 0) {
+                        self->compositor = static_cast<wl_compositor*>(
+                            wl_registry_bind(registry, name, &wl_compositor_interface, 4));
+                    } else if (strcmp(iface, wl_shm_interface.name) == 0) {
+                        self->shm = static_cast<wl_shm*>(
+                            wl_registry_bind(registry, name, &wl_shm_interface, 1));
+                    } else if (strcmp(iface, xdg_wm_base_interface.name) == 0) {
+                        self->wm_base = static_cast<xdg_wm_base*>(
+                            wl_registry_bind(registry, name, &xdg_wm_base_interface, 1));
+                    } else if (strcmp(iface, wp_presentation_interface.name) == 0) {
+                        self->presentation = static_cast<wp_presentation*>(
+                            wl_registry_bind(registry, name, &wp_presentation_interface, 1));
+                        wp_presentation_add_listener(
+                            self->presentation, &presentation_listener, self);
+                    }
+                },
+            .global_remove = [](void*, wl_registry*, uint32_t) {},
+        };
+
+        registry = wl_display_get_registry(display);
+        wl_registry_add_listener(registry, &registry_listener, this);
+
+        // The second roundtrip receives the clock announced by the presentation global.
+        wl_display_roundtrip(display);
+        wl_display_roundtrip(display);
+
+        if (!compositor || !shm || !wm_base) {
+            std::cerr << "Compositor is missing required globals." << std::endl;
+            return false;
+        }
+
+        static xdg_wm_base_listener const wm_base_listener = {
+            .ping = [](void*, xdg_wm_base* base, uint32_t serial) {
+                xdg_wm_base_pong(base, serial);
+            },
+        };
+        xdg_wm_base_add_listener(wm_base, &wm_base_listener, this);
+
+        if (!create_buffers()) {
+            return false;
+        }
+
+        static xdg_surface_listener const surface_listener = {
+            .configure =
+                [](void* data, xdg_surface* xsurface, uint32_t serial) {
+                    xdg_surface_ack_configure(xsurface, serial);
+                    static_cast<client*>(data)->configured = true;
+                },
+        };
+
+        surface = wl_compositor_create_surface(compositor);
+        xsurface = xdg_wm_base_get_xdg_surface(wm_base, surface);
+        xdg_surface_add_listener(xsurface, &surface_listener, this);
+        toplevel = xdg_surface_get_toplevel(xsurface);
+        xdg_toplevel_set_title(toplevel, "theseus-ship bench");
+        wl_surface_commit(surface);
+
+        while (!configured) {
+            if (wl_display_dispatch(display) == -1) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    bool create_buffers()
+    {
+        auto const stride = config.width * 4;
+        auto const buffer_size = stride * config.height;
+        shm_size = buffer_size * buffers.size();
+
+        auto fd = memfd_create("theseus-ship-bench", MFD_CLOEXEC);
+        if (fd < 0 || ftruncate(fd, shm_size) < 0) {
+            std::cerr << "Failed to create shm file: " << strerror(errno) << std::endl;
+            if (fd >= 0) {
+                close(fd);
+            }
+            return false;
+        }
+
+        shm_data = mmap(nullptr, shm_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (shm_data == MAP_FAILED) {
+            close(fd);
+            return false;
+        }
+
+        static wl_buffer_listener const buffer_listener = {
+            .release =
+                [](void* data, wl_buffer* buffer) {
+                    auto self = static_cast<client*>(data);
+                    for (size_t i = 0; i < self->buffers.size(); i++) {
+                        if (self->buffers[i] == buffer) {
+                            self->busy[i] = false;
+                        }
+                    }
+                },
+        };
+
+        auto pool = wl_shm_create_pool(shm, fd, shm_size);
+        for (size_t i = 0; i < buffers.size(); i++) {
+            auto pixels = static_cast<uint32_t*>(shm_data) + i * buffer_size / 4;
+            std::fill(pixels, pixels + buffer_size / 4, i ? 0xff336699 : 0xff996633);
+
+            buffers[i] = wl_shm_pool_create_buffer(pool,
+                                                   i * buffer_size,
+                                                   config.width,
+                                                   config.height,
+                                                   stride,
+                                                   WL_SHM_FORMAT_XRGB8888);
+            wl_buffer_add_listener(buffers[i], &buffer_listener, this);
+        }
+
+        wl_shm_pool_destroy(pool);
+        close(fd);
+        return true;
+    }
+
+    void commit_frame()
+    {
+        auto const index = frame_count % buffers.size();
+        if (busy[index]) {
+            results.skipped++;
+            return;
+        }
+
+        frame_count++;
+        busy[index] = true;
+
+        auto const commit_time = monotonic_ms();
+
+        static wl_callback_listener const frame_listener = {
+            .done =
+                [](void* data, wl_callback* callback, uint32_t) {
+                    auto frame = static_cast<pending_frame*>(data);
+                    frame->self->callback_latencies.push_back(monotonic_ms() - frame->commit_time);
+                    wl_callback_destroy(callback);
+                    delete frame;
+                },
+        };
+
+        auto callback = wl_surface_frame(surface);
+        wl_callback_add_listener(callback, &frame_listener, new pending_frame{this, commit_time});
+
+        if (presentation) {
+            static wp_presentation_feedback_listener const feedback_listener = {
+                .sync_output = [](void*, wp_presentation_feedback*, wl_output*) {},
+                .presented =
+                    [](void* data,
+                       wp_presentation_feedback* feedback,
+                       uint32_t tv_sec_hi,
+                       uint32_t tv_sec_lo,
+                       uint32_t tv_nsec,
+                       uint32_t,
+                       uint32_t,
+                       uint32_t,
+                       uint32_t) {
+                        auto frame = static_cast<pending_frame*>(data);
+                        auto self = frame->self;
+                        auto const sec = (static_cast<uint64_t>(tv_sec_hi) << 32) | tv_sec_lo;
+                        auto presented = sec * 1000. + tv_nsec / 1000000.;
+
+                        // Commit times are taken with CLOCK_MONOTONIC. Translate the timestamp if
+                        // the compositor announced a different clock.
+                        if (self->presentation_clock != CLOCK_MONOTONIC) {
+                            presented += monotonic_ms() - clock_ms(self->presentation_clock);
+                        }
+
+                        self->present_latencies.push_back(presented - frame->commit_time);
+                        if (self->last_present >= 0) {
+                            self->intervals.push_back(presented - self->last_present);
+                        }
+                        self->last_present = presented;
+
+                        wp_presentation_feedback_destroy(feedback);
+                        delete frame;
+                    },
+                .discarded =
+                    [](void* data, wp_presentation_feedback* feedback) {
+                        auto frame = static_cast<pending_frame*>(data);
+                        frame->self->results.discarded++;
+                        wp_presentation_feedback_destroy(feedback);
+                        delete frame;
+                    },
+            };
+
+            auto feedback = wp_presentation_feedback(presentation, surface);
+            wp_presentation_feedback_add_listener(
+                feedback, &feedback_listener, new pending_frame{this, commit_time});
+        }
+
+        wl_surface_attach(surface, buffers[index], 0, 0);
+        wl_surface_damage_buffer(surface, 0, 0, config.width, config.height);
+        wl_surface_commit(surface);
+    }
+
+    bool dispatch(int timeout)
+    {
+        while (wl_display_prepare_read(display) != 0) {
+            if (wl_display_dispatch_pending(display) == -1) {
+                return false;
+            }
+        }
+
+        wl_display_flush(display);
+
+        pollfd fds{.fd = wl_display_get_fd(display), .events = POLLIN, .revents = 0};
+        if (poll(&fds, 1, timeout) > 0) {
+            if (wl_display_read_events(display) == -1) {
+                return false;
+            }
+        } else {
+            wl_display_cancel_read(display);
+        }
+
+        return wl_display_dispatch_pending(display) != -1;
+    }
+
+    std::string socket;
+    bench_config const& config;
+    bench_results& results;
+
+    wl_display* display{nullptr};
+    wl_registry* registry{nullptr};
+    wl_compositor* compositor{nullptr};
+    wl_shm* shm{nullptr};
+    xdg_wm_base* wm_base{nullptr};
+    wp_presentation* presentation{nullptr};
+    clockid_t presentation_clock{CLOCK_MONOTONIC};
+
+    wl_surface* surface{nullptr};
+    xdg_surface* xsurface{nullptr};
+    xdg_toplevel* toplevel{nullptr};
+    bool configured{false};
+
+    void* shm_data{MAP_FAILED};
+    size_t shm_size{0};
+    std::array<wl_buffer*, 2> buffers{};
+    std::array<bool, 2> busy{};
+    size_t frame_count{0};
+
+    double last_present{-1};
+    std::vector<double> intervals;
+    std::vector<double> present_latencies;
+    std::vector<double> callback_latencies;
+};
+
+}
+
+int main(int argc, char* argv[])
+{
+    using namespace theseus_ship;
+
+    // Run on a headless backend with software rendering, so no GPU or input devices are needed.
+    auto set_default_env = [](char const* name, char const* value) {
+        if (!qEnvironmentVariableIsSet(name)) {
+            qputenv(name, value);
+        }
+    };
+    set_default_env("WLR_BACKENDS", "headless");
+    set_default_env("WLR_HEADLESS_OUTPUTS", "1");
+    set_default_env("WLR_LIBINPUT_NO_DEVICES", "1");
+    set_default_env("WLR_RENDERER_ALLOW_SOFTWARE", "1");
+
+    KLocalizedString::setApplicationDomain("kwin");
+    signal(SIGPIPE, SIG_IGN);
+
+    struct {
+        QCommandLineOption clients = {
+            QStringLiteral("clients"),
+            QStringLiteral("Number of synthetic clients."),
+            QStringLiteral("count"),
+            QStringLiteral("8"),
+        };
+        QCommandLineOption rate = {
+            QStringLiteral("rate"),
+            QStringLiteral("Commits per second of each client."),
+            QStringLiteral("hz"),
+            QStringLiteral("60"),
+        };
+        QCommandLineOption duration = {
+            QStringLiteral("duration"),
+            QStringLiteral("Duration of the benchmark."),
+            QStringLiteral("seconds"),
+            QStringLiteral("10"),
+        };
+        QCommandLineOption size = {
+            QStringLiteral("size"),
+            QStringLiteral("Buffer size of each client."),
+            QStringLiteral("WxH"),
+            QStringLiteral("256x256"),
+        };
+    } options;
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QStringLiteral("Theseus' Ship Wayland compositor benchmark"));
+    parser.addHelpOption();
+    parser.addOption(options.clients);
+    parser.addOption(options.rate);
+    parser.addOption(options.duration);
+    parser.addOption(options.size);
+
+    como::base::wayland::app_singleton app(argc, argv);
+    app_create_about_data();
+    parser.process(*app.qapp);
+
+    bench_config config;
+    config.clients = std::max(1, parser.value(options.clients).toInt());
+    config.rate = std::max(1, parser.value(options.rate).toInt());
+    config.duration = std::max(1, parser.value(options.duration).toInt());
+    if (auto size = parser.value(options.size).split(QLatin1Char('x')); size.size() == 2) {
+        config.width = std::max(1, size.at(0).toInt());
+        config.height = std::max(1, size.at(1).toInt());
+    }
+
+    using base_t = como::base::wayland::xwl_platform<base_mod>;
+    base_t base({
+        .config = como::base::config(KConfig::OpenFlag::SimpleConfig, ""),
+        .socket_name = "theseus-ship-bench-" + std::to_string(getpid()),
+        .flags = como::base::wayland::start_options::no_global_shortcuts,
+        .mode = como::base::operation_mode::wayland,
+    });
+
+    base.mod.render = std::make_unique<base_t::render_t>(base);
+    base.mod.input
+        = std::make_unique<base_t::input_t>(base, como::input::config(KConfig::NoGlobals));
+    base.mod.space = std::make_unique<base_t::space_t>(*base.mod.render, *base.mod.input);
+    base.mod.space->mod.desktop
+        = std::make_unique<como::desktop::kde::platform<base_t::space_t>>(*base.mod.space);
+
+    como::base::wayland::platform_start(base);
+
+    auto const socket = base.server->display->socket_name();
+
+    bench_results results;
+    std::vector<std::thread> threads;
+    std::atomic<int> running{config.clients};
+    std::unique_ptr<bench::cpu_usage> cpu;
+
+    QTimer::singleShot(0, app.qapp.get(), [&] {
+        printf("Running %d clients at %d Hz for %d s with %dx%d buffers\n",
+               config.clients,
+               config.rate,
+               config.duration,
+               config.width,
+               config.height);
+
+        cpu = std::make_unique<bench::cpu_usage>();
+
+        for (int i = 0; i < config.clients; i++) {
+            threads.emplace_back([&] {
+                client(socket, config, results).run();
+                cpu->add_client_thread();
+                if (--running == 0) {
+                    QMetaObject::invokeMethod(
+                        app.qapp.get(),
+                        [&] {
+                            cpu->stop();
+                            QCoreApplication::exit(0);
+                        },
+                        Qt::QueuedConnection);
+                }
+            });
+        }
+    });
+
+    auto const code = app.qapp->exec();
+
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    results.frame_intervals.print("Frame interval");
+    results.commit_to_present.print("Commit to present");
+    results.frame_callbacks.print("Commit to frame callback");
+    printf("%-28s %d\n", "Discarded frames", results.discarded.load());
+    printf("%-28s %d\n", "Skipped commits", results.skipped.load());
+    if (cpu) {
+        cpu->print("compositor thread");
+    }
+
+    if (results.failed) {
+        printf("%d clients failed\n", results.failed.load());
+        return 1;
+    }
+
+    return code;
+}
@@ -0,0 +1,411 @@
+/*
+SPDX-FileCopyrightText: 2026 agent <agent@local>
+
+SPDX-License-Identifier: GPL-2.0-or-later
+*/
+#include "bench.h"
+#include "main.h"
+#include "main_x11.h"
+#include "presentation.h"
+
+#include <como/base/x11/app_singleton.h>
+#include <como/base/x11/platform_helpers.h>
+
+#include <QCommandLineParser>
+#include <QTimer>
+#include <algorithm>
+#include <atomic>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <optional>
+#include <poll.h>
+#include <thread>
+#include <xcb/xcb.h>
+
+namespace
+{
+
+using namespace theseus_ship;
+
+struct bench_config {
+    int clients{8};
+    int windows{4};
+    int iterations{100};
+};
+
+struct bench_results {
+    bench::samples map;
+    bench::samples configure;
+    bench::samples restack;
+    bench::samples unmap;
+    bench::samples round_trip;
+    bench::samples frame_intervals;
+    std::atomic<int> timeouts{0};
+    std::atomic<int> failed{0};
+};
+
+// How long to wait for the window manager to handle a request.
+constexpr std::chrono::milliseconds reply_timeout{500};
+
+/**
+ * A synthetic X11 client that runs storms of map, configure, restack and unmap requests.
+ *
+ * Each client runs on its own thread with its own connection. The latency of an operation is the
+ * time from sending the request until the event that shows the window manager handled it arrives.
+ * Only events generated after the X server processed the request are considered, which is told by
+ * their sequence number. The round trip time to the X server is measured as a baseline.
+ */
+class client
+{
+public:
+    client(bench_config const& config, bench_results& results)
+        : config{config}
+        , results{results}
+    {
+    }
+
+    ~client()
+    {
+        if (connection) {
+            xcb_disconnect(connection);
+        }
+    }
+
+    void run()
+    {
+        connection = xcb_connect(nullptr, nullptr);
+        if (xcb_connection_has_error(connection)) {
+            std::cerr << "Client failed to connect to the X server." << std::endl;
+            results.failed++;
+            return;
+        }
+
+        auto screen = xcb_setup_roots_iterator(xcb_get_setup(connection)).data;
+        wm_state = intern_atom("WM_STATE");
+
+        std::vector<xcb_window_t> windows;
+
+        for (int i = 0; i < config.windows; i++) {
+            auto const win = xcb_generate_id(connection);
+            uint32_t const values[]
+                = {XCB_EVENT_MASK_STRUCTURE_NOTIFY | XCB_EVENT_MASK_PROPERTY_CHANGE};
+            xcb_create_window(connection,
+                              XCB_COPY_FROM_PARENT,
+                              win,
+                              screen->root,
+                              i * 20,
+                              i * 20,
+                              200,
+                              150,
+                              0,
+                              XCB_WINDOW_CLASS_INPUT_OUTPUT,
+                              screen->root_visual,
+                              XCB_CW_EVENT_MASK,
+                              values);
+            windows.push_back(win);
+        }
+        xcb_flush(connection);
+
+        for (int iteration = 0; iteration < config.iterations; iteration++) {
+            measure_round_trip();
+
+            // The map request is redirected to the window manager, which maps the window.
+            for (auto win : windows) {
+                auto const cookie = xcb_map_window(connection, win);
+                measure(results.map, cookie, [win](auto event) {
+                    return type(event) == XCB_MAP_NOTIFY
+                        && reinterpret_cast<xcb_map_notify_event_t*>(event)->window == win;
+                });
+            }
+
+            for (auto win : windows) {
+                uint16_t const width = 200 + iteration % 50;
+                uint16_t const height = 150 + iteration % 50;
+                uint32_t const values[] = {static_cast<uint32_t>(50 + iteration % 100),
+                                           static_cast<uint32_t>(50 + iteration % 80),
+                                           width,
+                                           height};
+                auto const cookie = xcb_configure_window(
+                    connection,
+                    win,
+                    XCB_CONFIG_WINDOW_X | XCB_CONFIG_WINDOW_Y | XCB_CONFIG_WINDOW_WIDTH
+                        | XCB_CONFIG_WINDOW_HEIGHT,
+                    values);
+                measure(results.configure, cookie, [win, width, height](auto event) {
+                    if (type(event) != XCB_CONFIGURE_NOTIFY) {
+                        return false;
+                    }
+                    auto notify = reinterpret_cast<xcb_configure_notify_event_t*>(event);
+                    return notify->window == win && notify->width == width
+                        && notify->height == height;
+                });
+            }
+
+            // The window manager restacks the frame the window has been reparented into, so the
+            // window itself sees no real ConfigureNotify. This relies on the window manager
+            // answering every configure request with a synthetic ConfigureNotify, which it does
+            // even where ICCCM does not require it.
+            for (auto win : windows) {
+                uint32_t const values[] = {XCB_STACK_MODE_ABOVE};
+                auto const cookie
+                    = xcb_configure_window(connection, win, XCB_CONFIG_WINDOW_STACK_MODE, values);
+                measure(results.restack, cookie, [win](auto event) {
+                    return type(event) == XCB_CONFIGURE_NOTIFY && synthetic(event)
+                        && reinterpret_cast<xcb_configure_notify_event_t*>(event)->window == win;
+                });
+            }
+
+            // Unmapping is not redirected. The window manager handles it by withdrawing the window,
+            // which changes or removes WM_STATE.
+            for (auto win : windows) {
+                auto const cookie = xcb_unmap_window(connection, win);
+                measure(results.unmap, cookie, [this, win](auto event) {
+                    if (type(event) != XCB_PROPERTY_NOTIFY) {
+                        return false;
+                    }
+                    auto notify = reinterpret_cast<xcb_property_notify_event_t*>(event);
+                    return notify->window == win && notify->atom == wm_state;
+                });
+            }
+        }
+
+        for (auto win : windows) {
+            xcb_destroy_window(connection, win);
+        }
+        xcb_flush(connection);
+    }
+
+private:
+    static uint8_t type(xcb_generic_event_t* event)
+    {
+        return event->response_type & ~0x80;
+    }
+
+    // Whether the event was sent by another client, in this case the window manager.
+    static bool synthetic(xcb_generic_event_t* event)
+    {
+        return event->response_type & 0x80;
+    }
+
+    xcb_atom_t intern_atom(char const* name)
+    {
+        auto reply = xcb_intern_atom_reply(
+            connection, xcb_intern_atom(connection, false, strlen(name), name), nullptr);
+        if (!reply) {
+            return XCB_ATOM_NONE;
+        }
+        auto const atom = reply->atom;
+        free(reply);
+        return atom;
+    }
+
+    void measure_round_trip()
+    {
+        auto const start = bench::clock::now();
+        free(xcb_get_input_focus_reply(connection, xcb_get_input_focus(connection), nullptr));
+        results.round_trip.add(bench::to_ms(bench::clock::now() - start));
+    }
+
+    template<typename Match>
+    void measure(bench::samples& samples, xcb_void_cookie_t request, Match match)
+    {
+        auto const start = bench::clock::now();
+        auto const deadline = start + reply_timeout;
+        xcb_flush(connection);
+
+        // Events carry the low 16 bits of the sequence number of the last request the server
+        // processed from this connection when it generated them.
+        auto const after_request = [request](xcb_generic_event_t* event) {
+            return static_cast<int16_t>(event->sequence - static_cast<uint16_t>(request.sequence))
+                >= 0;
+        };
+
+        while (true) {
+            while (auto event = xcb_poll_for_event(connection)) {
+                auto const matched = after_request(event) && match(event);
+                free(event);
+                if (matched) {
+                    samples.add(bench::to_ms(bench::clock::now() - start));
+                    return;
+                }
+            }
+
+            auto const now = bench::clock::now();
+            if (now >= deadline || xcb_connection_has_error(connection)) {
+                results.timeouts++;
+                return;
+            }
+
+            pollfd fds{.fd = xcb_get_file_descriptor(connection), .events = POLLIN, .revents = 0};
+            poll(&fds,
+                 1,
+                 std::chrono::duration_cast<std::chrono::milliseconds>(deadline - now).count() + 1);
+        }
+    }
+
+    bench_config const& config;
+    bench_results& results;
+    xcb_connection_t* connection{nullptr};
+    xcb_atom_t wm_state{XCB_ATOM_NONE};
+};
+
+void print_in_round_trips(bench_results& results)
+{
+    auto const round_trip = results.round_trip.mean();
+    if (round_trip <= 0) {
+        return;
+    }
+
+    for (auto [name, samples] : {std::pair{"Map", &results.map},
+                                 std::pair{"Configure", &results.configure},
+                                 std::pair{"Restack", &results.restack},
+                                 std::pair{"Unmap", &results.unmap}}) {
+        printf("%-28s %6.1f round trips\n",
+               (std::string(name) + " mean").c_str(),
+               samples->mean() / round_trip);
+    }
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+    using namespace theseus_ship;
+
+    KLocalizedString::setApplicationDomain("kwin");
+    signal(SIGPIPE, SIG_IGN);
+
+    struct {
+        QCommandLineOption clients = {
+            QStringLiteral("clients"),
+            QStringLiteral("Number of synthetic clients."),
+            QStringLiteral("count"),
+            QStringLiteral("8"),
+        };
+        QCommandLineOption windows = {
+            QStringLiteral("windows"),
+            QStringLiteral("Number of windows per client."),
+            QStringLiteral("count"),
+            QStringLiteral("4"),
+        };
+        QCommandLineOption iterations = {
+            QStringLiteral("iterations"),
+            QStringLiteral("Number of map, configure, restack and unmap rounds per window."),
+            QStringLiteral("count"),
+            QStringLiteral("100"),
+        };
+        QCommandLineOption replace = {
+            QStringLiteral("replace"),
+            QStringLiteral("Replace the window manager already running on the X server."),
+        };
+    } options;
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QStringLiteral("Theseus' Ship X11 window manager benchmark"));
+    parser.addHelpOption();
+    parser.addOption(options.clients);
+    parser.addOption(options.windows);
+    parser.addOption(options.iterations);
+    parser.addOption(options.replace);
+
+    como::base::x11::app_singleton app(argc, argv);
+    app_create_about_data();
+    parser.process(*app.qapp);
+
+    bench_config config;
+    config.clients = std::max(1, parser.value(options.clients).toInt());
+    config.windows = std::max(1, parser.value(options.windows).toInt());
+    config.iterations = std::max(1, parser.value(options.iterations).toInt());
+
+    using base_t = como::base::x11::platform<base_mod>;
+    base_t base(como::base::config(KConfig::OpenFlag::SimpleConfig, ""));
+
+    bench_results results;
+    std::vector<std::thread> threads;
+    std::atomic<int> running{config.clients};
+    std::unique_ptr<bench::cpu_usage> cpu;
+    std::optional<bench::clock::time_point> last_present;
+
+    auto start_clients = [&] {
+        printf("Running %d clients with %d windows each for %d iterations\n",
+               config.clients,
+               config.windows,
+               config.iterations);
+
+        cpu = std::make_unique<bench::cpu_usage>();
+
+        for (int i = 0; i < config.clients; i++) {
+            threads.emplace_back([&] {
+                client(config, results).run();
+                cpu->add_client_thread();
+                if (--running == 0) {
+                    QMetaObject::invokeMethod(
+                        app.qapp.get(),
+                        [&] {
+                            cpu->stop();
+                            QCoreApplication::exit(0);
+                        },
+                        Qt::QueuedConnection);
+                }
+            });
+        }
+    };
+
+    auto handle_ownership_claimed = [&] {
+        base.options
+            = como::base::create_options(como::base::operation_mode::x11, base.config.main);
+
+        if (!redirect_root_window(base)) {
+            std::cerr << "Another window manager is running on the X server (try using --replace)."
+                      << std::endl;
+            ::exit(1);
+        }
+
+        auto render = create_platforms(base);
+        render->start(*base.mod.space);
+
+        // Frame times are only collected while the clients run.
+        connect_frame_presented(*render, app.qapp.get(), [&] {
+            if (!cpu || running == 0) {
+                return;
+            }
+            auto const now = bench::clock::now();
+            if (last_present) {
+                results.frame_intervals.add(bench::to_ms(now - *last_present));
+            }
+            last_present = now;
+        });
+
+        como::base::x11::xcb::sync(base.x11_data.connection);
+        QTimer::singleShot(0, app.qapp.get(), start_clients);
+    };
+
+    como::base::x11::platform_start(base, parser.isSet(options.replace), handle_ownership_claimed);
+
+    auto const code = app.qapp->exec();
+
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    results.map.print("Map");
+    results.configure.print("Configure");
+    results.restack.print("Restack");
+    results.unmap.print("Unmap");
+    results.round_trip.print("Round trip");
+    print_in_round_trips(results);
+    results.frame_intervals.print("Frame interval");
+    printf("%-28s %d\n", "Timeouts", results.timeouts.load());
+    if (cpu) {
+        cpu->print("window manager thread");
+    }
+
+    if (results.failed) {
+        printf("%d clients failed\n", results.failed.load());
+        return 1;
+    }
+
+    return code;
+}
@@ -5,6 +5,7 @@
 */
 
 #cmakedefine01 HAVE_BREEZE_DECO
+#cmakedefine01 HAVE_LIBCAP
 #if HAVE_BREEZE_DECO
 #define BREEZE_KDECORATION_PLUGIN_ID "${BREEZE_KDECORATION_PLUGIN_ID}"
 #endif
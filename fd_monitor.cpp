@@ -0,0 +1,228 @@
+/*
+SPDX-FileCopyrightText: 2026 agent <agent@local>
+
+SPDX-License-Identifier: GPL-2.0-or-later
+*/
+#include "fd_monitor.h"
+
+#include <QDBusConnection>
+#include <QDebug>
+#include <QMetaObject>
+#include <QPointer>
+#include <QThreadPool>
+#include <algorithm>
+#include <climits>
+#include <cstdlib>
+#include <dirent.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace theseus_ship
+{
+
+namespace
+{
+
+constexpr std::chrono::seconds check_interval{60};
+
+// Warn when this percentage of the warn limit is reached.
+constexpr int warn_percentage{80};
+
+fd_monitor::kind classify(std::string const& target)
+{
+    using kind = fd_monitor::kind;
+
+    if (target.starts_with("/dmabuf:") || target.starts_with("anon_inode:dmabuf")) {
+        return kind::dmabuf;
+    }
+    if (target.starts_with("/memfd:") || target.starts_with("/dev/shm/")) {
+        return kind::shm;
+    }
+    if (target.starts_with("socket:")) {
+        return kind::socket;
+    }
+    if (target == "anon_inode:[eventfd]") {
+        return kind::eventfd;
+    }
+    if (target.starts_with("/dev/dri/")) {
+        return kind::drm;
+    }
+    return kind::other;
+}
+
+QString kind_name(fd_monitor::kind kind)
+{
+    using fd_kind = fd_monitor::kind;
+
+    switch (kind) {
+    case fd_kind::dmabuf:
+        return QStringLiteral("dmabuf");
+    case fd_kind::shm:
+        return QStringLiteral("shm");
+    case fd_kind::socket:
+        return QStringLiteral("socket");
+    case fd_kind::eventfd:
+        return QStringLiteral("eventfd");
+    case fd_kind::drm:
+        return QStringLiteral("drm");
+    case fd_kind::other:
+    default:
+        return QStringLiteral("other");
+    }
+}
+
+}
+
+fd_monitor::fd_monitor(int warn_limit, QObject* parent)
+    : QObject(parent)
+    , warn_limit{warn_limit}
+{
+    QDBusConnection::sessionBus().registerObject(QStringLiteral("/FileDescriptors"),
+                                                 this,
+                                                 QDBusConnection::ExportScriptableSlots);
+
+    QObject::connect(&timer, &QTimer::timeout, this, &fd_monitor::check);
+    timer.start(check_interval);
+}
+
+fd_monitor::~fd_monitor()
+{
+    QDBusConnection::sessionBus().unregisterObject(QStringLiteral("/FileDescriptors"));
+}
+
+fd_monitor::usage fd_monitor::scan()
+{
+    usage result;
+
+    rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur != RLIM_INFINITY) {
+        result.limit = static_cast<int>(limit.rlim_cur);
+    }
+
+    auto dir = opendir("/proc/self/fd");
+    if (!dir) {
+        return result;
+    }
+
+    auto const dir_fd = dirfd(dir);
+    char target[PATH_MAX];
+
+    while (auto entry = readdir(dir)) {
+        if (entry->d_name[0] == '.') {
+            continue;
+        }
+
+        auto const fd = atoi(entry->d_name);
+        if (fd == dir_fd) {
+            continue;
+        }
+
+        auto const len = readlinkat(dir_fd, entry->d_name, target, sizeof(target) - 1);
+        if (len < 0) {
+            continue;
+        }
+        target[len] = '\0';
+
+        auto const fd_kind = classify(target);
+        result.kinds[fd_kind]++;
+        result.total++;
+
+        if (fd_kind != kind::socket) {
+            continue;
+        }
+
+        ucred cred;
+        socklen_t cred_len = sizeof(cred);
+        if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &cred_len) == 0 && cred.pid > 0) {
+            result.clients[cred.pid]++;
+        }
+    }
+
+    closedir(dir);
+    return result;
+}
+
+QVariantMap fd_monitor::counts() const
+{
+    auto const usage = scan();
+
+    QVariantMap map;
+    for (auto const& [fd_kind, count] : usage.kinds) {
+        map.insert(kind_name(fd_kind), count);
+    }
+    map.insert(QStringLiteral("total"), usage.total);
+    map.insert(QStringLiteral("limit"), usage.limit);
+    map.insert(QStringLiteral("warnLimit"), warn_limit > 0 ? warn_limit : usage.limit);
+    return map;
+}
+
+QVariantMap fd_monitor::clientConnections() const
+{
+    auto const usage = scan();
+
+    QVariantMap map;
+    for (auto const& [pid, count] : usage.clients) {
+        map.insert(QString::number(pid), count);
+    }
+    return map;
+}
+
+void fd_monitor::check()
+{
+    // Reading the links of all open fds takes a while with many clients. Do it off the main
+    // thread. Fds closed meanwhile are skipped by the scan.
+    if (scanning) {
+        return;
+    }
+    scanning = true;
+
+    QThreadPool::globalInstance()->start([self = QPointer<fd_monitor>(this)] {
+        auto result = scan();
+        QMetaObject::invokeMethod(
+            self,
+            [self, result = std::move(result)] {
+                if (self) {
+                    self->handle_scan(result);
+                }
+            },
+            Qt::QueuedConnection);
+    });
+}
+
+void fd_monitor::handle_scan(usage const& usage)
+{
+    scanning = false;
+
+    auto const limit = warn_limit > 0 ? warn_limit : usage.limit;
+    if (limit <= 0) {
+        return;
+    }
+
+    auto const percentage = usage.total * 100 / limit;
+    if (percentage < warn_percentage) {
+        warned = false;
+        return;
+    }
+
+    if (warned) {
+        return;
+    }
+    warned = true;
+
+    auto kinds = usage.kinds;
+    qWarning() << "Running out of file descriptors:" << usage.total << "in use of" << limit
+               << "(raised limit" << usage.limit << "), dmabuf:" << kinds[kind::dmabuf]
+               << "shm:" << kinds[kind::shm] << "socket:" << kinds[kind::socket];
+
+    auto top_client = std::max_element(
+        usage.clients.cbegin(), usage.clients.cend(), [](auto const& lhs, auto const& rhs) {
+            return lhs.second < rhs.second;
+        });
+    if (top_client != usage.clients.cend()) {
+        qWarning() << "Most connections are held by process" << top_client->first << "with"
+                   << top_client->second;
+    }
+}
+
+}
@@ -0,0 +1,80 @@
+/*
+SPDX-FileCopyrightText: 2026 agent <agent@local>
+
+SPDX-License-Identifier: GPL-2.0-or-later
+*/
+#pragma once
+
+#include <QObject>
+#include <QTimer>
+#include <QVariantMap>
+#include <map>
+#include <string>
+
+namespace theseus_ship
+{
+
+/**
+ * Accounts for the file descriptors held open by the compositor.
+ *
+ * Open fds are classified by kind and sockets are attributed to the peer process they connect to.
+ * The result is exposed over D-Bus at /FileDescriptors.
+ *
+ * The periodic check runs on a worker thread. A warning is printed when the number of open fds
+ * approaches @c warn_limit or, if it is not set, the current RLIMIT_NOFILE.
+ */
+class fd_monitor : public QObject
+{
+    Q_OBJECT
+    Q_CLASSINFO("D-Bus Interface", "org.kde.KWin.FileDescriptors")
+
+public:
+    enum class kind {
+        dmabuf,
+        shm,
+        socket,
+        eventfd,
+        drm,
+        other,
+    };
+
+    struct usage {
+        std::map<kind, int> kinds;
+        // Socket connections per peer process id.
+        std::map<int, int> clients;
+        int total{0};
+        int limit{0};
+    };
+
+    /**
+     * @p warn_limit is the number of open fds the warning threshold is relative to. If it is not
+     * positive the current soft RLIMIT_NOFILE, which the compositor raised, is used.
+     */
+    explicit fd_monitor(int warn_limit, QObject* parent = nullptr);
+    ~fd_monitor() override;
+
+    static usage scan();
+
+public Q_SLOTS:
+    /**
+     * Number of open fds per kind, including the total count, the current limit and the limit
+     * the warning threshold is relative to.
+     */
+    Q_SCRIPTABLE QVariantMap counts() const;
+
+    /**
+     * Number of socket connections per peer process id.
+     */
+    Q_SCRIPTABLE QVariantMap clientConnections() const;
+
+private:
+    void check();
+    void handle_scan(usage const& usage);
+
+    QTimer timer;
+    int warn_limit;
+    bool scanning{false};
+    bool warned{false};
+};
+
+}
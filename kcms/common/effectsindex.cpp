@@ -0,0 +1,332 @@
+/*
+SPDX-FileCopyrightText: 2026 agent <agent@local>
+
+SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#include "effectsindex.h"
+
+#include <QCborArray>
+#include <QCborMap>
+#include <QCborValue>
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QLibrary>
+#include <QSaveFile>
+#include <QSet>
+#include <QStandardPaths>
+#include <QtConcurrent>
+
+namespace theseus_ship
+{
+
+// Increase when the layout of the index or the entries it contains change.
+static constexpr int indexVersion = 2;
+
+static QString indexPath()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation)
+        + QStringLiteral("/theseus-ship/effects-index.cbor");
+}
+
+static QCborArray directoryStamps()
+{
+    QCborArray stamps;
+
+    auto add = [&stamps](const QString& path) {
+        const QFileInfo info(path);
+        stamps.append(path);
+        stamps.append(info.exists() ? info.lastModified().toMSecsSinceEpoch() : -1);
+    };
+
+    const auto directories = EffectsIndex::directories();
+    for (const EffectsIndex::Directory& directory : directories) {
+        add(directory.path);
+
+        // Updating a package replaces files inside its own directory, which does not change the
+        // modification time of the parent directory.
+        QDirIterator it(directory.path, QDir::Dirs | QDir::NoDotAndDotDot);
+        while (it.hasNext()) {
+            add(it.next());
+        }
+    }
+
+    return stamps;
+}
+
+static QCborArray toCbor(const QList<KPluginMetaData>& plugins)
+{
+    QCborArray array;
+    for (const KPluginMetaData& plugin : plugins) {
+        const QCborMap entry{{QStringLiteral("id"), plugin.pluginId()},
+                             {QStringLiteral("file"), plugin.fileName()},
+                             {QStringLiteral("data"), QCborMap::fromJsonObject(plugin.rawData())}};
+        array.append(entry);
+    }
+    return array;
+}
+
+static QList<KPluginMetaData> fromCbor(const QCborArray& array)
+{
+    QList<KPluginMetaData> plugins;
+    plugins.reserve(array.size());
+
+    for (const QCborValue& value : array) {
+        const QCborMap entry = value.toMap();
+        QJsonObject data = entry.value(QStringLiteral("data")).toMap().toJsonObject();
+
+        // The id might have been derived from the file name. Store it explicitly so it is the same
+        // independent of the file the metadata is created from.
+        QJsonObject pluginData = data.value(QStringLiteral("KPlugin")).toObject();
+        if (!pluginData.contains(QStringLiteral("Id"))) {
+            pluginData.insert(QStringLiteral("Id"), entry.value(QStringLiteral("id")).toString());
+            data.insert(QStringLiteral("KPlugin"), pluginData);
+        }
+
+        plugins << KPluginMetaData(data, entry.value(QStringLiteral("file")).toString());
+    }
+
+    return plugins;
+}
+
+static bool readIndex(const QCborArray& stamps, EffectsIndex& index)
+{
+    QFile file(indexPath());
+    if (!file.open(QIODevice::ReadOnly) || file.size() == 0) {
+        return false;
+    }
+
+    const uchar* data = file.map(0, file.size());
+    if (!data) {
+        return false;
+    }
+
+    // The mapping stays valid until the file is closed, so the data does not need to be copied.
+    const QCborMap map
+        = QCborValue::fromCbor(
+              QByteArray::fromRawData(reinterpret_cast<const char*>(data), file.size()))
+              .toMap();
+
+    if (map.value(QStringLiteral("version")).toInteger() != indexVersion
+        || map.value(QStringLiteral("stamps")).toArray() != stamps) {
+        return false;
+    }
+
+    index.builtInEffects = fromCbor(map.value(QStringLiteral("builtin")).toArray());
+    index.javascriptEffects = fromCbor(map.value(QStringLiteral("javascript")).toArray());
+    index.pluginEffects = fromCbor(map.value(QStringLiteral("plugins")).toArray());
+    return true;
+}
+
+static void writeIndex(const QCborArray& stamps, const EffectsIndex& index)
+{
+    const QString path = indexPath();
+    if (!QDir().mkpath(QFileInfo(path).absolutePath())) {
+        return;
+    }
+
+    const QCborMap map{{QStringLiteral("version"), indexVersion},
+                       {QStringLiteral("stamps"), stamps},
+                       {QStringLiteral("builtin"), toCbor(index.builtInEffects)},
+                       {QStringLiteral("javascript"), toCbor(index.javascriptEffects)},
+                       {QStringLiteral("plugins"), toCbor(index.pluginEffects)}};
+
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return;
+    }
+    file.write(map.toCborValue().toCbor());
+    file.commit();
+}
+
+QVector<EffectsIndex::Directory> EffectsIndex::directories()
+{
+    QVector<Directory> directories;
+
+    const auto builtInPaths = QStandardPaths::locateAll(QStandardPaths::GenericDataLocation,
+                                                        QStringLiteral("kwin/builtin-effects"),
+                                                        QStandardPaths::LocateDirectory);
+    for (const QString& path : builtInPaths) {
+        directories.append({Source::BuiltIn, path});
+    }
+
+    // Packages from KNewStuff are installed here. Watching it before it exists lets the first
+    // installation be noticed.
+    const QString userPackagePath
+        = QStandardPaths::writableLocation(QStandardPaths::GenericDataLocation)
+        + QStringLiteral("/kwin/effects");
+    if (!QFileInfo::exists(userPackagePath)) {
+        directories.append({Source::Javascript, userPackagePath});
+    }
+
+    const auto packagePaths = QStandardPaths::locateAll(QStandardPaths::GenericDataLocation,
+                                                        QStringLiteral("kwin/effects"),
+                                                        QStandardPaths::LocateDirectory);
+    for (const QString& path : packagePaths) {
+        directories.append({Source::Javascript, path});
+    }
+
+    const auto libraryPaths = QCoreApplication::libraryPaths();
+    for (const QString& path : libraryPaths) {
+        directories.append({Source::Plugin, path + QStringLiteral("/kwin/effects/plugins")});
+    }
+
+    return directories;
+}
+
+QStringList EffectsIndex::entries(const Directory& directory)
+{
+    QStringList entries;
+
+    switch (directory.source) {
+    case Source::BuiltIn: {
+        QDirIterator it(directory.path, {QStringLiteral("*.json")}, QDir::Files);
+        while (it.hasNext()) {
+            entries << it.next();
+        }
+        break;
+    }
+    case Source::Javascript: {
+        QDirIterator it(directory.path, QDir::Dirs | QDir::NoDotAndDotDot);
+        while (it.hasNext()) {
+            entries << it.next();
+        }
+        break;
+    }
+    case Source::Plugin: {
+        QDirIterator it(directory.path, QDir::Files);
+        while (it.hasNext()) {
+            if (const QString path = it.next(); QLibrary::isLibrary(path)) {
+                entries << path;
+            }
+        }
+        break;
+    }
+    }
+
+    return entries;
+}
+
+// Only packages with the KWin/Effect structure are effects, as KPackage lists them. Older
+// packages declare it as service type.
+static bool isEffectPackage(const KPluginMetaData& metaData)
+{
+    const QString structure = QStringLiteral("KWin/Effect");
+    const QJsonObject data = metaData.rawData();
+
+    if (data.contains(QStringLiteral("KPackageStructure"))) {
+        return data.value(QStringLiteral("KPackageStructure")).toString() == structure;
+    }
+    return data.value(QStringLiteral("KPlugin"))
+        .toObject()
+        .value(QStringLiteral("ServiceTypes"))
+        .toArray()
+        .contains(structure);
+}
+
+KPluginMetaData EffectsIndex::read(Source source, const QString& entry)
+{
+    switch (source) {
+    case Source::BuiltIn:
+        return KPluginMetaData::fromJsonFile(entry);
+    case Source::Javascript: {
+        const auto metaData
+            = KPluginMetaData::fromJsonFile(entry + QStringLiteral("/metadata.json"));
+        return isEffectPackage(metaData) ? metaData : KPluginMetaData();
+    }
+    case Source::Plugin:
+        return KPluginMetaData(entry);
+    }
+
+    return {};
+}
+
+// Built-in and scripted effects are read from all of their directories by the worker that
+// discovers them, without going through KPackage, whose loader is not meant to be used from several
+// threads. An effect found in more than one directory is taken from the first, like KPackage does.
+static QList<KPluginMetaData> discoverEffects(EffectsIndex::Source source)
+{
+    QList<KPluginMetaData> ret;
+    QSet<QString> pluginIds;
+
+    const auto directories = EffectsIndex::directories();
+    for (const EffectsIndex::Directory& directory : directories) {
+        if (directory.source != source) {
+            continue;
+        }
+
+        const auto entries = EffectsIndex::entries(directory);
+        for (const QString& entry : entries) {
+            const KPluginMetaData metaData = EffectsIndex::read(source, entry);
+            if (metaData.isValid() && !pluginIds.contains(metaData.pluginId())) {
+                pluginIds.insert(metaData.pluginId());
+                ret << metaData;
+            }
+        }
+    }
+
+    return ret;
+}
+
+static QList<KPluginMetaData> discoverBuiltInEffects()
+{
+    return discoverEffects(EffectsIndex::Source::BuiltIn);
+}
+
+static QList<KPluginMetaData> discoverJavascriptEffects()
+{
+    return discoverEffects(EffectsIndex::Source::Javascript);
+}
+
+// KPluginMetaData::findPlugins only reads the metadata embedded in the plugin files and is
+// reentrant.
+static QList<KPluginMetaData> discoverPluginEffects()
+{
+    return KPluginMetaData::findPlugins(QStringLiteral("kwin/effects/plugins"));
+}
+
+EffectsIndex EffectsIndex::load(const ReadyCallback& ready)
+{
+    const QCborArray stamps = directoryStamps();
+
+    auto notify = [&ready](Source source, const QList<KPluginMetaData>& effects) {
+        if (ready) {
+            ready(source, effects);
+        }
+    };
+
+    EffectsIndex index;
+    if (readIndex(stamps, index)) {
+        notify(Source::BuiltIn, index.builtInEffects);
+        notify(Source::Javascript, index.javascriptEffects);
+        notify(Source::Plugin, index.pluginEffects);
+        return index;
+    }
+
+    auto discover = [&notify](Source source, auto discoverFunction) {
+        return QtConcurrent::run([&notify, source, discoverFunction] {
+            const QList<KPluginMetaData> effects = discoverFunction();
+            notify(source, effects);
+            return effects;
+        });
+    };
+
+    auto builtIn = discover(Source::BuiltIn, discoverBuiltInEffects);
+    auto javascript = discover(Source::Javascript, discoverJavascriptEffects);
+    auto plugins = discover(Source::Plugin, discoverPluginEffects);
+
+    index.builtInEffects = builtIn.result();
+    index.javascriptEffects = javascript.result();
+    index.pluginEffects = plugins.result();
+
+    writeIndex(stamps, index);
+    return index;
+}
+
+}
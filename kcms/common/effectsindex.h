@@ -0,0 +1,91 @@
+/*
+SPDX-FileCopyrightText: 2026 agent <agent@local>
+
+SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#pragma once
+
+#include <como_export.h>
+
+#include <KPluginMetaData>
+
+#include <QList>
+#include <QVector>
+
+#include <functional>
+
+namespace theseus_ship
+{
+
+/**
+ * Metadata of all installed effects, backed by an on-disk index.
+ *
+ * Discovering effects lists several directories and parses one JSON file per effect. The index
+ * stores the raw metadata of all effects in a single file in the cache directory together with
+ * the modification times of the searched directories and of the package directories inside them.
+ * While these are unchanged the metadata is read back from one mapping of the index file.
+ */
+class COMO_EXPORT EffectsIndex
+{
+public:
+    enum class Source {
+        BuiltIn,
+        Javascript,
+        Plugin,
+    };
+
+    /**
+     * A directory that is searched for effects of one source.
+     */
+    struct Directory {
+        Source source;
+        QString path;
+    };
+
+    using ReadyCallback
+        = std::function<void(Source source, const QList<KPluginMetaData>& effects)>;
+
+    /**
+     * Returns the metadata of all effects, from the index if it is still valid. Otherwise the
+     * three sources are discovered concurrently and the index is rewritten. Can be called from any
+     * thread.
+     *
+     * @param ready Called for each source as soon as its effects are known. The callback is
+     * invoked on the thread that discovered the source, which is not necessarily the caller's.
+     */
+    static EffectsIndex load(const ReadyCallback& ready = {});
+
+    /**
+     * Returns the directories that are searched for effects, in order of precedence. The user's
+     * directory for installed packages is included even if it does not exist yet.
+     */
+    static QVector<Directory> directories();
+
+    /**
+     * Returns the entries of @p directory that can describe an effect. These are JSON files for
+     * built-in effects, package directories for scripted effects and libraries for plugins.
+     */
+    static QStringList entries(const Directory& directory);
+
+    /**
+     * Reads the metadata of a single entry as returned by entries(). The metadata is invalid if
+     * the entry is a package that does not have the KWin/Effect structure.
+     */
+    static KPluginMetaData read(Source source, const QString& entry);
+
+    /**
+     * Effects compiled into KWin, described by JSON files in kwin/builtin-effects.
+     */
+    QList<KPluginMetaData> builtInEffects;
+    /**
+     * Scripted effects installed as KPackages in kwin/effects.
+     */
+    QList<KPluginMetaData> javascriptEffects;
+    /**
+     * Binary effect plugins in kwin/effects/plugins.
+     */
+    QList<KPluginMetaData> pluginEffects;
+};
+
+}
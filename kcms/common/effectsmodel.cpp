@@ -6,6 +6,7 @@ SPDX-License-Identifier: GPL-2.0-or-later
 */
 
 #include "effectsmodel.h"
+#include "effectsindex.h"
 
 #include <kwin_effects_interface.h>
 
@@ -13,15 +14,20 @@ SPDX-License-Identifier: GPL-2.0-or-later
 #include <KCMultiDialog>
 #include <KConfigGroup>
 #include <KLocalizedString>
-#include <KPackage/PackageLoader>
 #include <KPluginMetaData>
 
 #include <QDBusConnection>
 #include <QDBusInterface>
 #include <QDBusMessage>
 #include <QDBusPendingCall>
-#include <QDirIterator>
+#include <QDir>
+#include <QFileInfo>
+#include <QFileSystemWatcher>
 #include <QStandardPaths>
+#include <QTimer>
+#include <QtConcurrent>
+
+#include <memory>
 
 namespace theseus_ship
 {
@@ -130,7 +136,7 @@ QVariant EffectsModel::data(const QModelIndex& index, int role) const
         return {};
     }
 
-    const EffectData effect = m_effects.at(index.row());
+    const EffectData& effect = m_effects.at(index.row());
     switch (role) {
     case Qt::DisplayRole:
     case NameRole:
@@ -186,25 +192,7 @@ bool EffectsModel::setData(const QModelIndex& index, const QVariant& value, int
         // note: whenever the StatusRole is modified (even to the same value) the entry
         // gets marked as changed and will get saved to the config file. This means the
         // config file could get polluted
-        EffectData& data = m_effects[index.row()];
-        data.status = Status(value.toInt());
-        data.changed = data.status != data.originalStatus;
-        Q_EMIT dataChanged(index, index);
-
-        if (data.status == Status::Enabled && !data.exclusiveGroup.isEmpty()) {
-            // need to disable all other exclusive effects in the same category
-            for (int i = 0; i < m_effects.size(); ++i) {
-                if (i == index.row()) {
-                    continue;
-                }
-                EffectData& otherData = m_effects[i];
-                if (otherData.exclusiveGroup == data.exclusiveGroup) {
-                    otherData.status = Status::Disabled;
-                    otherData.changed = otherData.status != otherData.originalStatus;
-                    Q_EMIT dataChanged(this->index(i, 0), this->index(i, 0));
-                }
-            }
-        }
+        updateEffectStatuses({{m_effects.at(index.row()).serviceName, Status(value.toInt())}});
 
         return true;
     }
@@ -212,22 +200,12 @@ bool EffectsModel::setData(const QModelIndex& index, const QVariant& value, int
     return QAbstractItemModel::setData(index, value, role);
 }
 
-void EffectsModel::loadBuiltInEffects(const KConfigGroup& kwinConfig)
+QVector<EffectsModel::EffectData>
+EffectsModel::readBuiltInEffects(const QList<KPluginMetaData>& plugins)
 {
-    const QString rootDirectory = QStandardPaths::locate(QStandardPaths::GenericDataLocation,
-                                                         QStringLiteral("kwin/builtin-effects"),
-                                                         QStandardPaths::LocateDirectory);
-
-    const QStringList nameFilters{QStringLiteral("*.json")};
-    QDirIterator it(rootDirectory, nameFilters, QDir::Files);
-    while (it.hasNext()) {
-        it.next();
-
-        const KPluginMetaData metaData = KPluginMetaData::fromJsonFile(it.filePath());
-        if (!metaData.isValid()) {
-            continue;
-        }
+    QVector<EffectData> effects;
 
+    for (const KPluginMetaData& metaData : plugins) {
         EffectData effect;
         effect.name = metaData.name();
         effect.description = metaData.description();
@@ -238,6 +216,7 @@ void EffectsModel::loadBuiltInEffects(const KConfigGroup& kwinConfig)
         effect.untranslatedCategory = metaData.category();
         effect.category = translatedCategory(metaData.category());
         effect.serviceName = metaData.pluginId();
+        effect.entryPath = metaData.fileName();
         effect.iconName = metaData.iconName();
         effect.enabledByDefault = metaData.isEnabledByDefault();
         effect.supported = true;
@@ -254,28 +233,17 @@ void EffectsModel::loadBuiltInEffects(const KConfigGroup& kwinConfig)
             effect.internal = d.value("internal").toBool();
         }
 
-        const QString enabledKey = QStringLiteral("%1Enabled").arg(effect.serviceName);
-        if (kwinConfig.hasKey(enabledKey)) {
-            effect.status = effectStatus(
-                kwinConfig.readEntry(effect.serviceName + "Enabled", effect.enabledByDefault));
-        } else if (effect.enabledByDefaultFunction) {
-            effect.status = Status::EnabledUndeterminded;
-        } else {
-            effect.status = effectStatus(effect.enabledByDefault);
-        }
-
-        effect.originalStatus = effect.status;
-
-        if (shouldStore(effect)) {
-            m_pendingEffects << effect;
-        }
+        effects << effect;
     }
+
+    return effects;
 }
 
-void EffectsModel::loadJavascriptEffects(const KConfigGroup& kwinConfig)
+QVector<EffectsModel::EffectData>
+EffectsModel::readJavascriptEffects(const QList<KPluginMetaData>& plugins)
 {
-    const auto plugins = KPackage::PackageLoader::self()->listPackages(
-        QStringLiteral("KWin/Effect"), QStringLiteral("kwin/effects"));
+    QVector<EffectData> effects;
+
     for (const KPluginMetaData& plugin : plugins) {
         EffectData effect;
 
@@ -289,10 +257,8 @@ void EffectsModel::loadJavascriptEffects(const KConfigGroup& kwinConfig)
         effect.untranslatedCategory = plugin.category();
         effect.category = translatedCategory(plugin.category());
         effect.serviceName = plugin.pluginId();
+        effect.entryPath = QFileInfo(plugin.fileName()).absolutePath();
         effect.iconName = plugin.iconName();
-        effect.status = effectStatus(
-            kwinConfig.readEntry(effect.serviceName + "Enabled", plugin.isEnabledByDefault()));
-        effect.originalStatus = effect.status;
         effect.enabledByDefault = plugin.isEnabledByDefault();
         effect.enabledByDefaultFunction = false;
         effect.video = QUrl(plugin.value(QStringLiteral("X-KWin-Video-Url")));
@@ -322,15 +288,17 @@ void EffectsModel::loadJavascriptEffects(const KConfigGroup& kwinConfig)
             }
         }
 
-        if (shouldStore(effect)) {
-            m_pendingEffects << effect;
-        }
+        effects << effect;
     }
+
+    return effects;
 }
 
-void EffectsModel::loadPluginEffects(const KConfigGroup& kwinConfig)
+QVector<EffectsModel::EffectData>
+EffectsModel::readPluginEffects(const QList<KPluginMetaData>& pluginEffects)
 {
-    const auto pluginEffects = KPluginMetaData::findPlugins(QStringLiteral("kwin/effects/plugins"));
+    QVector<EffectData> effects;
+
     for (const KPluginMetaData& pluginEffect : pluginEffects) {
         if (!pluginEffect.isValid()) {
             continue;
@@ -343,6 +311,7 @@ void EffectsModel::loadPluginEffects(const KConfigGroup& kwinConfig)
         effect.untranslatedCategory = pluginEffect.category();
         effect.category = translatedCategory(pluginEffect.category());
         effect.serviceName = pluginEffect.pluginId();
+        effect.entryPath = pluginEffect.fileName();
         effect.iconName = pluginEffect.iconName();
         effect.enabledByDefault = pluginEffect.isEnabledByDefault();
         effect.supported = true;
@@ -368,10 +337,118 @@ void EffectsModel::loadPluginEffects(const KConfigGroup& kwinConfig)
 
         effect.website = QUrl(pluginEffect.website());
 
+        effects << effect;
+    }
+
+    return effects;
+}
+
+QVector<EffectsModel::EffectData> EffectsModel::readEffects(EffectsIndex::Source source,
+                                                            const QList<KPluginMetaData>& plugins)
+{
+    QVector<EffectData> effects;
+
+    switch (source) {
+    case EffectsIndex::Source::BuiltIn:
+        effects = readBuiltInEffects(plugins);
+        break;
+    case EffectsIndex::Source::Javascript:
+        effects = readJavascriptEffects(plugins);
+        break;
+    case EffectsIndex::Source::Plugin:
+        effects = readPluginEffects(plugins);
+        break;
+    }
+
+    // The directories are ordered by source first, so built-in effects take precedence over
+    // scripted ones and these over plugins, like they did when all were listed. Effects not found
+    // in any directory, like static plugins, come last.
+    const auto directories = EffectsIndex::directories();
+    for (EffectData& effect : effects) {
+        const QString directory = QFileInfo(effect.entryPath).absolutePath();
+        effect.precedence = directories.count();
+        for (int i = 0; i < directories.count(); ++i) {
+            if (directories.at(i).source == source
+                && QDir::cleanPath(directories.at(i).path) == directory) {
+                effect.precedence = i;
+                break;
+            }
+        }
+    }
+
+    return effects;
+}
+
+bool EffectsModel::lessThan(const EffectData& a, const EffectData& b)
+{
+    if (a.category == b.category) {
+        if (a.exclusiveGroup == b.exclusiveGroup) {
+            return a.name < b.name;
+        }
+        return a.exclusiveGroup < b.exclusiveGroup;
+    }
+    return a.category < b.category;
+}
+
+void EffectsModel::load(LoadOptions options)
+{
+    ++m_lastSerial;
+    m_loadOptions = options;
+    m_discoveredEffects.clear();
+    m_pendingBatches = 0;
+    m_discoveryFinished = false;
+
+    // The effect directories are listed on the worker as well, right before discovery. The listing
+    // is taken over and the directories are watched once discovery is done.
+    auto listing = std::make_shared<Listing>();
+
+    delete m_discoveryWatcher;
+    m_discoveryWatcher = new QFutureWatcher<QVector<EffectData>>(this);
+
+    connect(m_discoveryWatcher, &QFutureWatcherBase::resultReadyAt, this, [this](int resultIndex) {
+        m_pendingBatches++;
+        querySupport(prepareBatch(m_discoveryWatcher->resultAt(resultIndex)),
+                     [this](const QVector<EffectData>& batch) {
+                         mergeBatch(batch, m_loadOptions == LoadOptions::KeepDirty);
+                         m_pendingBatches--;
+                         finishLoad();
+                     });
+    });
+    connect(m_discoveryWatcher, &QFutureWatcherBase::finished, this, [this, listing] {
+        m_entries = listing->entries;
+        watchPaths(listing->watchPaths);
+
+        m_discoveryFinished = true;
+        finishLoad();
+
+        // Catch changes made between the listing and installing the watches.
+        rescanDirectories();
+    });
+
+    // The three sources are discovered concurrently off the GUI thread. Each source is handed over
+    // as one batch once it is ready, so the model fills in while discovery continues.
+    auto discover = [listing](QPromise<QVector<EffectData>>& promise) {
+        *listing = listDirectories();
+        EffectsIndex::load(
+            [&promise](EffectsIndex::Source source, const QList<KPluginMetaData>& effects) {
+                promise.addResult(readEffects(source, effects));
+            });
+    };
+    m_discoveryWatcher->setFuture(QtConcurrent::run(discover));
+}
+
+QVector<EffectsModel::EffectData> EffectsModel::prepareBatch(QVector<EffectData> effects) const
+{
+    KConfigGroup kwinConfig(KSharedConfig::openConfig("kwinrc"), QStringLiteral("Plugins"));
+
+    QVector<EffectData> batch;
+    batch.reserve(effects.count());
+
+    for (EffectData& effect : effects) {
         const QString enabledKey = QStringLiteral("%1Enabled").arg(effect.serviceName);
         if (kwinConfig.hasKey(enabledKey)) {
-            effect.status = effectStatus(
-                kwinConfig.readEntry(effect.serviceName + "Enabled", effect.enabledByDefault));
+            effect.status
+                = effectStatus(kwinConfig.readEntry(enabledKey, effect.enabledByDefault));
         } else if (effect.enabledByDefaultFunction) {
             effect.status = Status::EnabledUndeterminded;
         } else {
@@ -381,116 +458,370 @@ void EffectsModel::loadPluginEffects(const KConfigGroup& kwinConfig)
         effect.originalStatus = effect.status;
 
         if (shouldStore(effect)) {
-            m_pendingEffects << effect;
+            batch << effect;
         }
     }
+
+    return batch;
 }
 
-void EffectsModel::load(LoadOptions options)
+void EffectsModel::querySupport(QVector<EffectData> batch,
+                                std::function<void(const QVector<EffectData>&)> done)
 {
-    KConfigGroup kwinConfig(KSharedConfig::openConfig("kwinrc"), QStringLiteral("Plugins"));
+    const int serial = m_lastSerial;
+
+    OrgKdeKwinEffectsInterface* interface = effectsInterface();
+
+    if (!interface->isValid()) {
+        done(batch);
+        return;
+    }
 
-    m_pendingEffects.clear();
-    loadBuiltInEffects(kwinConfig);
-    loadJavascriptEffects(kwinConfig);
-    loadPluginEffects(kwinConfig);
-
-    std::sort(m_pendingEffects.begin(),
-              m_pendingEffects.end(),
-              [](const EffectData& a, const EffectData& b) {
-                  if (a.category == b.category) {
-                      if (a.exclusiveGroup == b.exclusiveGroup) {
-                          return a.name < b.name;
-                      }
-                      return a.exclusiveGroup < b.exclusiveGroup;
-                  }
-                  return a.category < b.category;
-              });
-
-    auto commit = [this, options] {
-        if (options == LoadOptions::KeepDirty) {
-            for (const EffectData& oldEffect : qAsConst(m_effects)) {
-                if (!oldEffect.changed) {
-                    continue;
+    QStringList effectNames;
+    effectNames.reserve(batch.count());
+    for (const EffectData& data : qAsConst(batch)) {
+        effectNames.append(data.serviceName);
+    }
+
+    QDBusPendingCallWatcher* watcher
+        = new QDBusPendingCallWatcher(interface->areEffectsSupported(effectNames), this);
+    connect(watcher,
+            &QDBusPendingCallWatcher::finished,
+            this,
+            [=, this](QDBusPendingCallWatcher* self) mutable {
+                self->deleteLater();
+
+                if (m_lastSerial != serial) {
+                    return;
                 }
-                auto effectIt = std::find_if(m_pendingEffects.begin(),
-                                             m_pendingEffects.end(),
-                                             [oldEffect](const EffectData& data) {
-                                                 return data.serviceName == oldEffect.serviceName;
-                                             });
-                if (effectIt == m_pendingEffects.end()) {
-                    continue;
+
+                const QDBusPendingReply<QList<bool>> reply = *self;
+                if (!reply.isError() && reply.value().count() == batch.count()) {
+                    const QList<bool> supportedValues = reply.value();
+                    for (int i = 0; i < batch.count(); ++i) {
+                        batch[i].supported = supportedValues.at(i);
+                    }
                 }
-                effectIt->status = oldEffect.status;
-                effectIt->changed = effectIt->status != effectIt->originalStatus;
+
+                done(batch);
+            });
+}
+
+void EffectsModel::mergeBatch(QVector<EffectData> batch, bool keepDirty)
+{
+    // Sources are discovered concurrently and directory changes arrive in any order. Effects with
+    // the same plugin id are therefore resolved by their precedence, not by the order they arrive.
+    QVector<EffectData> effects;
+    QHash<QString, int> effectIndex;
+
+    for (EffectData& effect : batch) {
+        const auto discovered = m_discoveredEffects.constFind(effect.serviceName);
+        if (discovered != m_discoveredEffects.constEnd()
+            && discovered.value() < effect.precedence) {
+            continue;
+        }
+        m_discoveredEffects.insert(effect.serviceName, effect.precedence);
+
+        if (const auto it = effectIndex.constFind(effect.serviceName);
+            it != effectIndex.constEnd()) {
+            effects[it.value()] = effect;
+        } else {
+            effectIndex.insert(effect.serviceName, effects.count());
+            effects << effect;
+        }
+    }
+
+    QVector<EffectData> added;
+    QVector<int> changedRows;
+    QVector<int> movedRows;
+
+    for (EffectData& effect : effects) {
+        const auto it = m_rowByServiceName.constFind(effect.serviceName);
+        if (it == m_rowByServiceName.constEnd()) {
+            added << effect;
+            continue;
+        }
+
+        const int row = it.value();
+        EffectData& current = m_effects[row];
+
+        if (keepDirty && current.changed) {
+            effect.status = current.status;
+            effect.changed = effect.status != effect.originalStatus;
+        }
+
+        if (lessThan(effect, current) || lessThan(current, effect)) {
+            // The effect moves to another position. Reinsert it with the new effects.
+            movedRows << row;
+            added << effect;
+            continue;
+        }
+
+        current = effect;
+        changedRows << row;
+    }
+
+    emitDataChanged(changedRows);
+    removeEffectRows(movedRows);
+
+    std::sort(added.begin(), added.end(), lessThan);
+
+    // Effects that end up next to each other are inserted together.
+    int firstInsertedRow = m_effects.count();
+    for (auto it = added.cbegin(); it != added.cend();) {
+        const int row
+            = std::distance(m_effects.begin(),
+                            std::upper_bound(m_effects.begin(), m_effects.end(), *it, lessThan));
+
+        auto last = it + 1;
+        if (row == m_effects.count()) {
+            last = added.cend();
+        }
+        while (last != added.cend() && lessThan(*last, m_effects.at(row))) {
+            ++last;
+        }
+
+        const int count = std::distance(it, last);
+        beginInsertRows({}, row, row + count - 1);
+        m_effects.insert(row, count, EffectData());
+        std::copy(it, last, m_effects.begin() + row);
+        endInsertRows();
+
+        firstInsertedRow = std::min(firstInsertedRow, row);
+        it = last;
+    }
+
+    updateRowIndex(firstInsertedRow);
+}
+
+void EffectsModel::finishLoad()
+{
+    if (!m_discoveryFinished || m_pendingBatches > 0) {
+        return;
+    }
+
+    // Remove effects that have not been discovered again.
+    QVector<int> staleRows;
+    for (int row = 0; row < m_effects.count(); ++row) {
+        if (!m_discoveredEffects.contains(m_effects.at(row).serviceName)) {
+            staleRows << row;
+        }
+    }
+    removeEffectRows(staleRows);
+
+    Q_EMIT loaded();
+}
+
+EffectsModel::Listing EffectsModel::listDirectories()
+{
+    Listing listing;
+
+    const auto directories = EffectsIndex::directories();
+    for (const EffectsIndex::Directory& directory : directories) {
+        // Watch the closest existing parent of directories that do not exist yet.
+        QString watchPath = directory.path;
+        while (!QFileInfo::exists(watchPath) && watchPath != QDir::rootPath()) {
+            watchPath = QFileInfo(watchPath).absolutePath();
+        }
+        listing.watchPaths.insert(watchPath);
+
+        const auto paths = EffectsIndex::entries(directory);
+        for (const QString& path : paths) {
+            if (listing.entries.contains(path)) {
+                continue;
             }
+            listing.entries.insert(
+                path, {directory.source, QFileInfo(path).lastModified().toMSecsSinceEpoch()});
+
+            // Files inside a package are replaced without touching the parent directory.
+            if (directory.source == EffectsIndex::Source::Javascript) {
+                listing.watchPaths.insert(path);
+            }
+        }
+    }
+
+    return listing;
+}
+
+void EffectsModel::watchPaths(QSet<QString> paths)
+{
+    if (!m_directoryWatcher) {
+        m_directoryWatcher = new QFileSystemWatcher(this);
+
+        // Installing a package touches the directories several times in a row.
+        m_directoryChangeTimer = new QTimer(this);
+        m_directoryChangeTimer->setSingleShot(true);
+        m_directoryChangeTimer->setInterval(100);
+
+        connect(m_directoryWatcher,
+                &QFileSystemWatcher::directoryChanged,
+                m_directoryChangeTimer,
+                qOverload<>(&QTimer::start));
+        connect(m_directoryChangeTimer,
+                &QTimer::timeout,
+                this,
+                &EffectsModel::applyDirectoryChanges);
+    }
+
+    const QStringList watched = m_directoryWatcher->directories();
+    for (const QString& path : watched) {
+        if (!paths.remove(path)) {
+            m_directoryWatcher->removePath(path);
         }
+    }
+    if (!paths.isEmpty()) {
+        m_directoryWatcher->addPaths(paths.values());
+    }
+}
 
-        beginResetModel();
-        m_effects = m_pendingEffects;
-        m_pendingEffects.clear();
-        endResetModel();
+void EffectsModel::rescanDirectories()
+{
+    if (m_listingWatcher) {
+        m_rescanPending = true;
+        return;
+    }
 
-        Q_EMIT loaded();
+    m_listingWatcher = new QFutureWatcher<Listing>(this);
+    connect(m_listingWatcher, &QFutureWatcherBase::finished, this, [this] {
+        const Listing listing = m_listingWatcher->result();
+        m_listingWatcher->deleteLater();
+        m_listingWatcher = nullptr;
+
+        applyListing(listing);
+
+        if (m_rescanPending) {
+            m_rescanPending = false;
+            rescanDirectories();
+        }
+    });
+    m_listingWatcher->setFuture(QtConcurrent::run(&EffectsModel::listDirectories));
+}
+
+void EffectsModel::applyDirectoryChanges()
+{
+    rescanDirectories();
+}
+
+void EffectsModel::applyListing(const Listing& listing)
+{
+    if (!m_discoveryFinished || m_pendingBatches > 0) {
+        // Let the running load finish first, it might already contain the changes.
+        if (m_directoryChangeTimer) {
+            m_directoryChangeTimer->start();
+        }
+        return;
+    }
+
+    const QHash<QString, Entry>& entries = listing.entries;
+
+    QVector<EffectData> changed;
+    QSet<QString> readPaths;
+    QSet<QString> removed;
+
+    auto read = [&](const QString& path, const Entry& entry) {
+        if (readPaths.contains(path)) {
+            return;
+        }
+        readPaths.insert(path);
+
+        if (const KPluginMetaData metaData = EffectsIndex::read(entry.source, path);
+            metaData.isValid()) {
+            changed << readEffects(entry.source, {metaData});
+        }
     };
 
-    OrgKdeKwinEffectsInterface interface(
-        QStringLiteral("org.kde.KWin"), QStringLiteral("/Effects"), QDBusConnection::sessionBus());
+    for (auto it = entries.cbegin(); it != entries.cend(); ++it) {
+        const auto old = m_entries.constFind(it.key());
+        if (old == m_entries.cend() || old->modified != it->modified) {
+            read(it.key(), it.value());
+        }
+    }
 
-    if (interface.isValid()) {
-        QStringList effectNames;
-        effectNames.reserve(m_pendingEffects.count());
-        for (const EffectData& data : qAsConst(m_pendingEffects)) {
-            effectNames.append(data.serviceName);
+    for (auto it = m_entries.cbegin(); it != m_entries.cend(); ++it) {
+        if (entries.contains(it.key())) {
+            continue;
         }
+        removed.insert(it.key());
 
-        const int serial = ++m_lastSerial;
+        // An entry of the same name in a directory of lower precedence was hidden so far.
+        const QString fileName = QFileInfo(it.key()).fileName();
+        for (auto other = entries.cbegin(); other != entries.cend(); ++other) {
+            if (other->source == it->source && QFileInfo(other.key()).fileName() == fileName) {
+                read(other.key(), other.value());
+            }
+        }
+    }
 
-        QDBusPendingCallWatcher* watcher
-            = new QDBusPendingCallWatcher(interface.areEffectsSupported(effectNames), this);
-        connect(watcher,
-                &QDBusPendingCallWatcher::finished,
-                this,
-                [=, this](QDBusPendingCallWatcher* self) {
-                    self->deleteLater();
+    m_entries = entries;
+    watchPaths(listing.watchPaths);
 
-                    if (m_lastSerial != serial) {
-                        return;
-                    }
+    QVector<int> removedRows;
+    for (int row = 0; row < m_effects.count(); ++row) {
+        if (removed.contains(m_effects.at(row).entryPath)) {
+            m_discoveredEffects.remove(m_effects.at(row).serviceName);
+            removedRows << row;
+        }
+    }
+    removeEffectRows(removedRows);
 
-                    const QDBusPendingReply<QList<bool>> reply = *self;
-                    if (reply.isError()) {
-                        commit();
-                        return;
-                    }
+    if (!changed.isEmpty()) {
+        querySupport(prepareBatch(changed), [this](const QVector<EffectData>& batch) {
+            mergeBatch(batch, true);
+        });
+    }
+}
 
-                    const QList<bool> supportedValues = reply.value();
-                    if (supportedValues.count() != effectNames.count()) {
-                        return;
-                    }
+void EffectsModel::removeEffectRows(QVector<int> rows)
+{
+    if (rows.isEmpty()) {
+        return;
+    }
 
-                    for (int i = 0; i < effectNames.size(); ++i) {
-                        const bool supported = supportedValues.at(i);
-                        const QString effectName = effectNames.at(i);
-
-                        auto it = std::find_if(m_pendingEffects.begin(),
-                                               m_pendingEffects.end(),
-                                               [effectName](const EffectData& data) {
-                                                   return data.serviceName == effectName;
-                                               });
-                        if (it == m_pendingEffects.end()) {
-                            continue;
-                        }
-
-                        if ((*it).supported != supported) {
-                            (*it).supported = supported;
-                        }
-                    }
+    std::sort(rows.begin(), rows.end());
+
+    // Remove from the back so the remaining rows keep their position, contiguous rows at once.
+    for (int last = rows.count() - 1; last >= 0;) {
+        int first = last;
+        while (first > 0 && rows.at(first - 1) == rows.at(first) - 1) {
+            --first;
+        }
+
+        const int firstRow = rows.at(first);
+        const int lastRow = rows.at(last);
+
+        beginRemoveRows({}, firstRow, lastRow);
+        for (int row = firstRow; row <= lastRow; ++row) {
+            m_rowByServiceName.remove(m_effects.at(row).serviceName);
+        }
+        m_effects.remove(firstRow, lastRow - firstRow + 1);
+        endRemoveRows();
+
+        last = first - 1;
+    }
+
+    updateRowIndex(rows.constFirst());
+}
+
+void EffectsModel::updateRowIndex(int first)
+{
+    for (int row = first; row < m_effects.count(); ++row) {
+        m_rowByServiceName[m_effects.at(row).serviceName] = row;
+    }
+}
+
+void EffectsModel::emitDataChanged(QVector<int> rows)
+{
+    std::sort(rows.begin(), rows.end());
+
+    // Contiguous rows are reported in one signal.
+    for (int first = 0; first < rows.count();) {
+        int last = first;
+        while (last + 1 < rows.count() && rows.at(last + 1) <= rows.at(last) + 1) {
+            ++last;
+        }
 
-                    commit();
-                });
-    } else {
-        commit();
+        Q_EMIT dataChanged(index(rows.at(first), 0), index(rows.at(last), 0));
+        first = last + 1;
     }
 }
 
@@ -499,6 +830,46 @@ void EffectsModel::updateEffectStatus(const QModelIndex& rowIndex, Status effect
     setData(rowIndex, static_cast<int>(effectState), StatusRole);
 }
 
+void EffectsModel::updateEffectStatuses(const QHash<QString, Status>& statuses)
+{
+    QVector<int> changedRows;
+    QSet<QString> enabledGroups;
+
+    auto update = [this, &changedRows](int row, Status status) {
+        EffectData& data = m_effects[row];
+        data.status = status;
+        data.changed = data.status != data.originalStatus;
+        changedRows << row;
+    };
+
+    for (auto it = statuses.cbegin(); it != statuses.cend(); ++it) {
+        const auto row = m_rowByServiceName.constFind(it.key());
+        if (row == m_rowByServiceName.cend()) {
+            continue;
+        }
+
+        update(row.value(), it.value());
+
+        const QString& exclusiveGroup = m_effects.at(row.value()).exclusiveGroup;
+        if (it.value() == Status::Enabled && !exclusiveGroup.isEmpty()) {
+            enabledGroups.insert(exclusiveGroup);
+        }
+    }
+
+    if (!enabledGroups.isEmpty()) {
+        // need to disable all other exclusive effects in the same category
+        for (int row = 0; row < m_effects.count(); ++row) {
+            const EffectData& data = m_effects.at(row);
+            if (enabledGroups.contains(data.exclusiveGroup)
+                && statuses.value(data.serviceName, Status::Disabled) != Status::Enabled) {
+                update(row, Status::Disabled);
+            }
+        }
+    }
+
+    emitDataChanged(changedRows);
+}
+
 void EffectsModel::save()
 {
     KConfigGroup kwinConfig(KSharedConfig::openConfig("kwinrc"), QStringLiteral("Plugins"));
@@ -533,10 +904,9 @@ void EffectsModel::save()
 
     kwinConfig.sync();
 
-    OrgKdeKwinEffectsInterface interface(
-        QStringLiteral("org.kde.KWin"), QStringLiteral("/Effects"), QDBusConnection::sessionBus());
+    OrgKdeKwinEffectsInterface* interface = effectsInterface();
 
-    if (!interface.isValid()) {
+    if (!interface->isValid()) {
         return;
     }
 
@@ -547,26 +917,52 @@ void EffectsModel::save()
               return data.status == Status::Disabled;
           });
 
+    // All calls are sent as one batch and KWin handles them in order. The replies are waited
+    // for once at the end, so the changes have been applied when saving returns, for example
+    // before the module is closed, but the calls do not cost a round trip each.
+    QList<QDBusPendingCall> calls;
+    calls.reserve(dirtyEffects.count());
+
     for (auto it = dirtyEffects.begin(); it != split; ++it) {
-        interface.unloadEffect(it->serviceName);
+        calls << interface->unloadEffect(it->serviceName);
     }
 
     for (auto it = split; it != dirtyEffects.end(); ++it) {
-        interface.loadEffect(it->serviceName);
+        calls << interface->loadEffect(it->serviceName);
+    }
+
+    for (QDBusPendingCall& call : calls) {
+        call.waitForFinished();
     }
 }
 
+OrgKdeKwinEffectsInterface* EffectsModel::effectsInterface()
+{
+    // Creating the interface looks up the owner of the service with a blocking call. Keep one
+    // instance around, it tracks owner changes afterwards.
+    if (!m_effectsInterface) {
+        m_effectsInterface = new OrgKdeKwinEffectsInterface(QStringLiteral("org.kde.KWin"),
+                                                            QStringLiteral("/Effects"),
+                                                            QDBusConnection::sessionBus(),
+                                                            this);
+    }
+    return m_effectsInterface;
+}
+
 void EffectsModel::defaults()
 {
-    for (int i = 0; i < m_effects.count(); ++i) {
-        const auto& effect = m_effects.at(i);
+    QHash<QString, Status> statuses;
+
+    for (const EffectData& effect : qAsConst(m_effects)) {
         if (effect.enabledByDefaultFunction && effect.status != Status::EnabledUndeterminded) {
-            updateEffectStatus(index(i, 0), Status::EnabledUndeterminded);
+            statuses.insert(effect.serviceName, Status::EnabledUndeterminded);
         } else if (static_cast<bool>(effect.status) != effect.enabledByDefault) {
-            updateEffectStatus(index(i, 0),
-                               effect.enabledByDefault ? Status::Enabled : Status::Disabled);
+            statuses.insert(effect.serviceName,
+                            effect.enabledByDefault ? Status::Enabled : Status::Disabled);
         }
     }
+
+    updateEffectStatuses(statuses);
 }
 
 bool EffectsModel::isDefaults() const
@@ -591,14 +987,11 @@ bool EffectsModel::needsSave() const
 
 QModelIndex EffectsModel::findByPluginId(const QString& pluginId) const
 {
-    auto it
-        = std::find_if(m_effects.constBegin(),
-                       m_effects.constEnd(),
-                       [pluginId](const EffectData& data) { return data.serviceName == pluginId; });
-    if (it == m_effects.constEnd()) {
+    const auto it = m_rowByServiceName.constFind(pluginId);
+    if (it == m_rowByServiceName.constEnd()) {
         return {};
     }
-    return index(std::distance(m_effects.constBegin(), it), 0);
+    return index(it.value(), 0);
 }
 
 void EffectsModel::requestConfigure(const QModelIndex& index, QWindow* transientParent)
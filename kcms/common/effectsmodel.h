@@ -7,15 +7,26 @@ SPDX-License-Identifier: GPL-2.0-or-later
 
 #pragma once
 
+#include "effectsindex.h"
+
 #include <como_export.h>
 
+#include <KPluginMetaData>
 #include <KSharedConfig>
 
 #include <QAbstractItemModel>
+#include <QFutureWatcher>
+#include <QSet>
 #include <QString>
 #include <QUrl>
 #include <QWindow>
 
+#include <functional>
+
+class OrgKdeKwinEffectsInterface;
+class QFileSystemWatcher;
+class QTimer;
+
 namespace theseus_ship
 {
 
@@ -148,6 +159,17 @@ public:
      */
     void updateEffectStatus(const QModelIndex& rowIndex, Status effectState);
 
+    /**
+     * Changes the status of several effects at once.
+     *
+     * Other effects in the exclusive group of an effect that gets enabled are disabled, unless
+     * they are enabled by the same call. Changed rows are reported together.
+     *
+     * @param statuses The new state for each effect, by plugin id.
+     * @note In order to actually apply the change, you have to call save().
+     */
+    void updateEffectStatuses(const QHash<QString, Status>& statuses);
+
     /**
      * This enum type is used to specify load options.
      */
@@ -162,12 +184,25 @@ public:
     /**
      * Loads effects.
      *
-     * You have to call this method in order to populate the model.
+     * You have to call this method in order to populate the model. Effects are discovered in the
+     * background and added in batches, the loaded() signal is emitted once all are known.
      */
     void load(LoadOptions options = LoadOptions::None);
 
+    /**
+     * Updates the effects whose files were added, changed or removed since they were loaded.
+     *
+     * The effect directories are watched after the first load() and changes are applied
+     * automatically. Call this to apply them right away, for example after installing effects.
+     * The directories are listed in the background and the model is updated once that is done.
+     */
+    void applyDirectoryChanges();
+
     /**
      * Saves status of each modified effect.
+     *
+     * The unloadEffect() and loadEffect() calls for all modified effects are sent as one batch
+     * and their replies are waited for together.
      */
     void save();
 
@@ -233,6 +268,11 @@ protected:
         bool changed = false;
         QString configModule;
         QVariantList configArgs;
+        // The JSON file, package directory or library the effect was read from.
+        QString entryPath;
+        // Position of the directory of the entry in EffectsIndex::directories(). Of several
+        // effects with the same plugin id the one with the lowest value is shown.
+        int precedence = 0;
     };
 
     /**
@@ -244,14 +284,60 @@ protected:
     virtual bool shouldStore(const EffectData& data) const;
 
 private:
-    void loadBuiltInEffects(const KConfigGroup& kwinConfig);
-    void loadJavascriptEffects(const KConfigGroup& kwinConfig);
-    void loadPluginEffects(const KConfigGroup& kwinConfig);
+    static QVector<EffectData> readBuiltInEffects(const QList<KPluginMetaData>& plugins);
+    static QVector<EffectData> readJavascriptEffects(const QList<KPluginMetaData>& plugins);
+    static QVector<EffectData> readPluginEffects(const QList<KPluginMetaData>& plugins);
+    static bool lessThan(const EffectData& a, const EffectData& b);
+
+    static QVector<EffectData> readEffects(EffectsIndex::Source source,
+                                           const QList<KPluginMetaData>& plugins);
+
+    QVector<EffectData> prepareBatch(QVector<EffectData> effects) const;
+    void querySupport(QVector<EffectData> batch,
+                      std::function<void(const QVector<EffectData>&)> done);
+    void mergeBatch(QVector<EffectData> batch, bool keepDirty);
+    void finishLoad();
+
+    struct Entry {
+        EffectsIndex::Source source;
+        qint64 modified;
+    };
+
+    struct Listing {
+        QHash<QString, Entry> entries;
+        QSet<QString> watchPaths;
+    };
+
+    static Listing listDirectories();
+    void watchPaths(QSet<QString> paths);
+    void rescanDirectories();
+    void applyListing(const Listing& listing);
+
+    OrgKdeKwinEffectsInterface* effectsInterface();
+
+    void removeEffectRows(QVector<int> rows);
+    void updateRowIndex(int first);
+    void emitDataChanged(QVector<int> rows);
 
     QVector<EffectData> m_effects;
-    QVector<EffectData> m_pendingEffects;
+    QHash<QString, int> m_rowByServiceName;
     int m_lastSerial = -1;
 
+    QFutureWatcher<QVector<EffectData>>* m_discoveryWatcher = nullptr;
+    // The precedence of the shown effect by plugin id.
+    QHash<QString, int> m_discoveredEffects;
+    LoadOptions m_loadOptions = LoadOptions::None;
+    int m_pendingBatches = 0;
+    bool m_discoveryFinished = false;
+
+    QHash<QString, Entry> m_entries;
+    QFileSystemWatcher* m_directoryWatcher = nullptr;
+    QTimer* m_directoryChangeTimer = nullptr;
+    QFutureWatcher<Listing>* m_listingWatcher = nullptr;
+    bool m_rescanPending = false;
+
+    OrgKdeKwinEffectsInterface* m_effectsInterface = nullptr;
+
     Q_DISABLE_COPY(EffectsModel)
 };
 
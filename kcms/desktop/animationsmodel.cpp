@@ -127,12 +127,14 @@ void AnimationsModel::load()
 
 void AnimationsModel::save()
 {
+    QHash<QString, Status> statuses;
     for (int i = 0; i < rowCount(); ++i) {
         const auto status = (m_animationEnabled && i == m_animationIndex)
             ? EffectsModel::Status::Enabled
             : EffectsModel::Status::Disabled;
-        updateEffectStatus(index(i, 0), status);
+        statuses.insert(index(i, 0).data(ServiceNameRole).toString(), status);
     }
+    updateEffectStatuses(statuses);
 
     EffectsModel::save();
 }
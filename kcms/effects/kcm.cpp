@@ -65,7 +65,7 @@ void DesktopEffectsKCM::defaults()
 
 void DesktopEffectsKCM::onGHNSEntriesChanged()
 {
-    m_model->load(EffectsModel::LoadOptions::KeepDirty);
+    m_model->applyDirectoryChanges();
 }
 
 void DesktopEffectsKCM::configure(const QString& pluginId, QQuickItem* context)
@@ -12,12 +12,16 @@
 #include <QDBusConnection>
 #include <QDBusMessage>
 #include <QDBusPendingReply>
+#include <QSet>
 
 #include <KConfig>
+#include <KConfigGroup>
 #include <KLocalizedString>
 #include <KPluginFactory>
 #include <KWindowSystem>
+#include <memory>
 #include <netwm_def.h>
+#include <vector>
 
 namespace theseus_ship
 {
@@ -41,6 +45,9 @@ KCMKWinRules::KCMKWinRules(QObject* parent,
         }
     });
     connect(m_rulesModel, &RulesModel::dataChanged, this, [this] {
+        if (!m_editIndex.isValid()) {
+            return;
+        }
         Q_EMIT m_ruleBookModel->dataChanged(m_editIndex, m_editIndex, {});
     });
     connect(m_ruleBookModel, &RuleBookModel::dataChanged, this, &KCMKWinRules::updateNeedsSave);
@@ -117,9 +124,12 @@ void KCMKWinRules::load()
 
 void KCMKWinRules::save()
 {
-    m_ruleBookModel->save();
+    const QStringList changedGroups = m_ruleBookModel->save();
+    if (changedGroups.isEmpty()) {
+        return;
+    }
 
-    // Notify kwin to reload configuration
+    // Notify kwin to reload configuration. It can't reload single rules yet.
     QDBusMessage message = QDBusMessage::createSignal("/KWin", "org.kde.KWin", "reloadConfig");
     QDBusConnection::sessionBus().send(message);
 }
@@ -254,15 +264,42 @@ void KCMKWinRules::exportToFile(const QUrl& path, const QList<int>& indexes)
     }
 
     for (int index : indexes) {
-        if (index < 0 || index > m_ruleBookModel->rowCount()) {
+        if (index < 0 || index >= m_ruleBookModel->rowCount()) {
             continue;
         }
         auto const* origin = m_ruleBookModel->ruleSettingsAt(index);
         como::win::rules::settings exported(config, origin->description());
 
         RuleBookModel::copySettingsTo(&exported, *origin);
-        exported.save();
+
+        // Saving the settings would sync the file for every rule. Write the entries only and sync
+        // once at the end.
+        auto const items = exported.items();
+        for (auto item : items) {
+            item->writeConfig(config.data());
+        }
     }
+
+    config->sync();
+}
+
+// Rules with the same signature apply to the same windows.
+static QString matchSignature(como::win::rules::settings const& settings)
+{
+    auto const unimportant = como::enum_index(como::win::rules::name_match::unimportant);
+
+    auto property = [unimportant](int match, const QString& value) {
+        return match == unimportant ? QString::number(match)
+                                    : QString::number(match) + QLatin1Char(':') + value;
+    };
+
+    return QStringList{property(settings.wmclassmatch(), settings.wmclass().toLower()),
+                       QString::number(settings.wmclasscomplete()),
+                       property(settings.windowrolematch(), settings.windowrole().toLower()),
+                       property(settings.titlematch(), settings.title()),
+                       property(settings.clientmachinematch(), settings.clientmachine()),
+                       QString::number(settings.types())}
+        .join(QChar(0));
 }
 
 void KCMKWinRules::importFromFile(const QUrl& path)
@@ -273,42 +310,88 @@ void KCMKWinRules::importFromFile(const QUrl& path)
         return;
     }
 
-    for (const QString& groupName : groups) {
-        como::win::rules::settings settings(config, groupName);
+    // Imported rules replace existing ones with the same description or, failing that, with the
+    // same match signature. Both lookups are done once instead of scanning the rules per group.
+    QHash<QString, int> rowByDescription;
+    QHash<QString, int> rowBySignature;
+    for (int row = m_ruleBookModel->rowCount() - 1; row >= 0; --row) {
+        auto const* settings = m_ruleBookModel->ruleSettingsAt(row);
+        rowByDescription.insert(settings->description(), row);
+        rowBySignature.insert(matchSignature(*settings), row);
+    }
+
+    // The file is read in one pass. Changes are collected and applied to the model afterwards, new
+    // rules with a single insertion. Later groups take precedence over earlier ones.
+    std::vector<std::unique_ptr<como::win::rules::settings>> imported;
+    QHash<int, como::win::rules::settings const*> replaced;
+    QSet<int> removed;
+    QVector<como::win::rules::settings const*> added;
+    QHash<QString, int> addedByDescription;
+    QHash<QString, int> addedBySignature;
 
-        const bool remove = settings.deleteRule();
-        const QString importDescription = settings.description();
+    for (const QString& groupName : groups) {
+        // Skip groups that can't be imported before parsing all of their entries.
+        const KConfigGroup group = config->group(groupName);
+        const QString importDescription = group.readEntry("Description", QString());
         if (importDescription.isEmpty()) {
             continue;
         }
 
-        // Try to find a rule with the same description to replace
-        int newIndex = -2;
-        for (int index = 0; index < m_ruleBookModel->rowCount(); index++) {
-            if (m_ruleBookModel->descriptionAt(index) == importDescription) {
-                newIndex = index;
-                break;
+        auto settings = std::make_unique<como::win::rules::settings>(config, groupName);
+        const QString signature = matchSignature(*settings);
+
+        if (settings->deleteRule()) {
+            if (const int row = rowByDescription.value(importDescription, -1); row >= 0) {
+                removed.insert(row);
+                replaced.remove(row);
+            }
+            if (const int pending = addedByDescription.value(importDescription, -1);
+                pending >= 0) {
+                added[pending] = nullptr;
             }
+            continue;
         }
 
-        if (remove) {
-            m_ruleBookModel->removeRow(newIndex);
+        int row = rowByDescription.value(importDescription, -1);
+        if (row < 0) {
+            row = rowBySignature.value(signature, -1);
+        }
+        if (row >= 0 && !removed.contains(row)) {
+            replaced.insert(row, settings.get());
+            imported.push_back(std::move(settings));
             continue;
         }
 
-        if (newIndex < 0) {
-            newIndex = m_ruleBookModel->rowCount();
-            m_ruleBookModel->insertRow(newIndex);
+        int pending = addedByDescription.value(importDescription, -1);
+        if (pending < 0) {
+            pending = addedBySignature.value(signature, -1);
         }
+        if (pending >= 0) {
+            added[pending] = settings.get();
+        } else {
+            pending = added.size();
+            added.append(settings.get());
+        }
+        addedByDescription.insert(importDescription, pending);
+        addedBySignature.insert(signature, pending);
+        imported.push_back(std::move(settings));
+    }
+    added.removeAll(nullptr);
 
-        m_ruleBookModel->setRuleSettingsAt(newIndex, settings);
+    for (auto it = replaced.cbegin(); it != replaced.cend(); ++it) {
+        m_ruleBookModel->setRuleSettingsAt(it.key(), *it.value());
 
         // Reset rule editor if the current rule changed when importing
-        if (m_editIndex.row() == newIndex) {
-            m_rulesModel->setSettings(m_ruleBookModel->ruleSettingsAt(newIndex));
+        if (m_editIndex.row() == it.key()) {
+            m_rulesModel->setSettings(m_ruleBookModel->ruleSettingsAt(it.key()));
         }
     }
 
+    m_ruleBookModel->appendRuleSettings(added);
+
+    m_ruleBookModel->removeRules(QList<int>(removed.cbegin(), removed.cend()));
+
+    Q_EMIT editIndexChanged();
     updateNeedsSave();
 }
 
@@ -326,7 +409,12 @@ QModelIndex KCMKWinRules::findRuleWithProperties(const QVariantMap& info, bool w
     int bestMatchRow = -1;
     int bestMatchScore = 0;
 
-    for (int row = 0; row < m_ruleBookModel->rowCount(); row++) {
+    // Rules without exact class match are too generic. The candidates only contain rules with
+    // exact class match for this window's class and type.
+    auto const candidates
+        = m_ruleBookModel->exactWmclassCandidates(wmclass_class, wmclass_name, type);
+
+    for (int row : candidates) {
         auto const* settings = m_ruleBookModel->ruleSettingsAt(row);
 
         // If the rule doesn't match try the next one
@@ -341,10 +429,6 @@ QModelIndex KCMKWinRules::findRuleWithProperties(const QVariantMap& info, bool w
         }
         /* clang-format on */
 
-        if (settings->wmclassmatch() != como::enum_index(como::win::rules::name_match::exact)) {
-            continue; // too generic
-        }
-
         // Now that the rule matches the window, check the quality of the match
         // It stablishes a quality depending on the match policy of the rule
         int score = 0;
@@ -7,6 +7,8 @@
 
 #include <como/utils/algorithm.h>
 
+#include <algorithm>
+
 namespace theseus_ship
 {
 
@@ -14,6 +16,24 @@ RuleBookModel::RuleBookModel(QObject* parent)
     : QAbstractListModel(parent)
     , m_ruleBook(new como::win::rules::book_settings(this))
 {
+    connect(this, &RuleBookModel::modelReset, this, &RuleBookModel::invalidateMatchIndex);
+    connect(this, &RuleBookModel::rowsInserted, this, &RuleBookModel::invalidateMatchIndex);
+    connect(this, &RuleBookModel::rowsRemoved, this, &RuleBookModel::invalidateMatchIndex);
+    connect(this, &RuleBookModel::rowsMoved, this, &RuleBookModel::invalidateMatchIndex);
+    // Rules edited in the rules model are reported as data changes of their row without roles.
+    connect(this,
+            &RuleBookModel::dataChanged,
+            this,
+            [this](QModelIndex const& topLeft,
+                   QModelIndex const& bottomRight,
+                   QList<int> const& roles) {
+                // Description changes do not affect matching. Removed rows have been handled
+                // already.
+                if (!roles.isEmpty() || !topLeft.isValid() || !bottomRight.isValid()) {
+                    return;
+                }
+                invalidateMatchIndexRows(topLeft.row(), bottomRight.row());
+            });
 }
 
 RuleBookModel::~RuleBookModel()
@@ -97,13 +117,13 @@ bool RuleBookModel::insertRows(int row, int count, const QModelIndex& parent)
 
 bool RuleBookModel::removeRows(int row, int count, const QModelIndex& parent)
 {
-    if (row < 0 || row > rowCount() || parent.isValid()) {
+    if (row < 0 || row + count > rowCount() || parent.isValid()) {
         return false;
     }
 
     beginRemoveRows(parent, row, row + count - 1);
     for (int i = 0; i < count; i++) {
-        m_ruleBook->removeRuleSettingsAt(row + i);
+        m_ruleBook->removeRuleSettingsAt(row);
     }
     endRemoveRows();
 
@@ -160,7 +180,7 @@ void RuleBookModel::setDescriptionAt(int row, const QString& description)
 
     m_ruleBook->ruleSettingsAt(row)->setDescription(description);
 
-    Q_EMIT dataChanged(index(row), index(row), {});
+    Q_EMIT dataChanged(index(row), index(row), {DescriptionRole});
 }
 
 void RuleBookModel::setRuleSettingsAt(int row, como::win::rules::settings const& settings)
@@ -172,18 +192,79 @@ void RuleBookModel::setRuleSettingsAt(int row, como::win::rules::settings const&
     Q_EMIT dataChanged(index(row), index(row), {});
 }
 
+void RuleBookModel::appendRuleSettings(QVector<como::win::rules::settings const*> const& settings)
+{
+    if (settings.isEmpty()) {
+        return;
+    }
+
+    const int first = rowCount();
+    beginInsertRows(QModelIndex(), first, first + settings.size() - 1);
+    for (int i = 0; i < settings.size(); i++) {
+        copySettingsTo(m_ruleBook->insertRuleSettingsAt(first + i), *settings.at(i));
+    }
+    endInsertRows();
+}
+
+void RuleBookModel::removeRules(QList<int> rows)
+{
+    std::sort(rows.begin(), rows.end());
+    rows.erase(std::unique(rows.begin(), rows.end()), rows.end());
+
+    // Remove from the back so the remaining rows keep their position.
+    int last = rows.size() - 1;
+    while (last >= 0) {
+        int first = last;
+        while (first > 0 && rows.at(first - 1) == rows.at(first) - 1) {
+            first--;
+        }
+        removeRows(rows.at(first), last - first + 1);
+        last = first - 1;
+    }
+}
+
 void RuleBookModel::load()
 {
     beginResetModel();
 
     m_ruleBook->load();
+    m_storedGroups = ruleGroups();
 
     endResetModel();
 }
 
-void RuleBookModel::save()
+QStringList RuleBookModel::save()
 {
+    const QStringList groups = ruleGroups();
+    QStringList changed;
+
+    // Whether the settings changed can only be told before they are saved.
+    for (int row = 0; row < groups.size(); row++) {
+        if (m_storedGroups.value(row) != groups.at(row)
+            || m_ruleBook->ruleSettingsAt(row)->isSaveNeeded()) {
+            changed << groups.at(row);
+        }
+    }
+    for (const QString& group : std::as_const(m_storedGroups)) {
+        if (!groups.contains(group)) {
+            changed << group;
+        }
+    }
+
     m_ruleBook->save();
+    m_storedGroups = groups;
+
+    return changed;
+}
+
+QStringList RuleBookModel::ruleGroups() const
+{
+    QStringList groups;
+    groups.reserve(rowCount());
+    for (int row = 0; row < rowCount(); row++) {
+        groups << m_ruleBook->ruleSettingsAt(row)->currentGroup();
+    }
+    return groups;
 }
 
 bool RuleBookModel::isSaveNeeded()
@@ -191,6 +272,85 @@ bool RuleBookModel::isSaveNeeded()
     return m_ruleBook->usrIsSaveNeeded();
 }
 
+QVector<int> RuleBookModel::exactWmclassCandidates(const QByteArray& wmclassClass,
+                                                   const QByteArray& wmclassName,
+                                                   NET::WindowType type) const
+{
+    if (!m_matchIndex.valid) {
+        buildMatchIndex();
+    }
+
+    // Rules with complete class match compare against name and class. The keys are lower case,
+    // the final match is left to the rule itself.
+    const QByteArray wmclass = wmclassClass.toLower();
+    const QByteArray completeWmclass = wmclassName.toLower() + ' ' + wmclass;
+    QVector<int> rows = m_matchIndex.rowsByWmclass.value(wmclass)
+        + m_matchIndex.rowsByWmclass.value(completeWmclass);
+
+    const NET::WindowType matchType = type == NET::Unknown ? NET::Normal : type;
+    rows.erase(std::remove_if(rows.begin(),
+                              rows.end(),
+                              [this, matchType](int row) {
+                                  const NET::WindowTypes types = m_matchIndex.types.at(row);
+                                  return types != NET::AllTypesMask
+                                      && !NET::typeMatchesMask(matchType, types);
+                              }),
+               rows.end());
+
+    std::sort(rows.begin(), rows.end());
+    return rows;
+}
+
+void RuleBookModel::invalidateMatchIndex()
+{
+    m_matchIndex.valid = false;
+}
+
+void RuleBookModel::invalidateMatchIndexRows(int first, int last)
+{
+    if (!m_matchIndex.valid) {
+        return;
+    }
+    if (first < 0 || last >= rowCount() || first > last) {
+        invalidateMatchIndex();
+        return;
+    }
+
+    for (auto& rows : m_matchIndex.rowsByWmclass) {
+        rows.erase(std::remove_if(rows.begin(),
+                                  rows.end(),
+                                  [first, last](int row) { return row >= first && row <= last; }),
+                   rows.end());
+    }
+
+    for (int row = first; row <= last; ++row) {
+        indexRow(row);
+    }
+}
+
+void RuleBookModel::indexRow(int row) const
+{
+    auto const* settings = m_ruleBook->ruleSettingsAt(row);
+    m_matchIndex.types[row] = NET::WindowTypes(settings->types());
+
+    if (settings->wmclassmatch() != como::enum_index(como::win::rules::name_match::exact)) {
+        return;
+    }
+    m_matchIndex.rowsByWmclass[settings->wmclass().toLower().toUtf8()] << row;
+}
+
+void RuleBookModel::buildMatchIndex() const
+{
+    m_matchIndex.rowsByWmclass.clear();
+    m_matchIndex.types.resize(rowCount());
+
+    for (int row = 0; row < rowCount(); ++row) {
+        indexRow(row);
+    }
+
+    m_matchIndex.valid = true;
+}
+
 void RuleBookModel::copySettingsTo(como::win::rules::settings* dest,
                                    como::win::rules::settings const& source)
 {
@@ -10,6 +10,7 @@
 #include <como/win/rules/rules_settings.h>
 
 #include <QAbstractListModel>
+#include <netwm_def.h>
 
 namespace theseus_ship
 {
@@ -44,17 +45,59 @@ public:
 
     como::win::rules::settings* ruleSettingsAt(int row) const;
     void setRuleSettingsAt(int row, como::win::rules::settings const& settings);
+    /**
+     * Appends copies of @p settings as new rules with a single row insertion.
+     */
+    void appendRuleSettings(QVector<como::win::rules::settings const*> const& settings);
+
+    /**
+     * Removes the rules at @p rows. Adjacent rows are removed together, with one row removal for
+     * each contiguous range.
+     */
+    void removeRules(QList<int> rows);
 
     void load();
-    void save();
+    /**
+     * Writes the rule book and returns the groups of the rules that changed since the last load
+     * or save. These are rules with changed settings, inserted, removed and moved rules.
+     */
+    QStringList save();
     bool isSaveNeeded();
 
+    /**
+     * Returns the rows of rules that match the window class exactly and that apply to windows of
+     * the given type, in ascending order. Only these rules can match a window of that class with
+     * an exact class match. Other match properties are not checked.
+     *
+     * The lookup goes through an index that is rebuilt on first use after rules were added,
+     * removed or moved. Edited rules are reindexed on their own.
+     */
+    QVector<int> exactWmclassCandidates(const QByteArray& wmclassClass,
+                                        const QByteArray& wmclassName,
+                                        NET::WindowType type) const;
+
     // Helper function to copy RuleSettings properties
     static void copySettingsTo(como::win::rules::settings* dest,
                                como::win::rules::settings const& source);
 
 private:
+    void invalidateMatchIndex();
+    void invalidateMatchIndexRows(int first, int last);
+    void buildMatchIndex() const;
+    void indexRow(int row) const;
+    QStringList ruleGroups() const;
+
     como::win::rules::book_settings* m_ruleBook;
+    // Rule groups in the order they were last loaded or saved.
+    QStringList m_storedGroups;
+
+    struct MatchIndex {
+        bool valid = false;
+        // Rows of rules with exact class match by their lower case class string.
+        QHash<QByteArray, QVector<int>> rowsByWmclass;
+        QVector<NET::WindowTypes> types;
+    };
+    mutable MatchIndex m_matchIndex;
 };
 
 } // namespace
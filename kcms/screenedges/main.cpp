@@ -18,6 +18,7 @@ SPDX-License-Identifier: GPL-2.0-or-later
 #include <KPluginFactory>
 #include <QVBoxLayout>
 
+#include "effectsindex.h"
 #include "kwinscreenedgeconfigform.h"
 #include "kwinscreenedgedata.h"
 #include "kwinscreenedgeeffectsettings.h"
@@ -129,33 +130,6 @@ void KWinScreenEdgesConfig::defaults()
 //-----------------------------------------------------------------------------
 // Monitor
 
-static QList<KPluginMetaData> listBuiltinEffects()
-{
-    const QString rootDirectory = QStandardPaths::locate(QStandardPaths::GenericDataLocation,
-                                                         QStringLiteral("kwin/builtin-effects"),
-                                                         QStandardPaths::LocateDirectory);
-
-    QList<KPluginMetaData> ret;
-
-    const QStringList nameFilters{QStringLiteral("*.json")};
-    QDirIterator it(rootDirectory, nameFilters, QDir::Files);
-    while (it.hasNext()) {
-        it.next();
-        if (const KPluginMetaData metaData = KPluginMetaData::fromJsonFile(it.filePath());
-            metaData.isValid()) {
-            ret.append(metaData);
-        }
-    }
-
-    return ret;
-}
-
-static QList<KPluginMetaData> listScriptedEffects()
-{
-    return KPackage::PackageLoader::self()->listPackages(QStringLiteral("KWin/Effect"),
-                                                         QStringLiteral("kwin/effects/"));
-}
-
 void KWinScreenEdgesConfig::monitorInit()
 {
     m_form->monitorAddItem(i18n("No Action"));
@@ -180,7 +154,8 @@ void KWinScreenEdgesConfig::monitorInit()
     m_form->monitorAddItem(i18n("Toggle alternative window switching"));
 
     KConfigGroup config(m_config, QStringLiteral("Plugins"));
-    const auto effects = listBuiltinEffects() << listScriptedEffects();
+    const auto index = EffectsIndex::load();
+    const auto effects = index.builtInEffects + index.javascriptEffects;
 
     for (KPluginMetaData const& effect : effects) {
         if (!effect.value(QStringLiteral("X-KWin-Border-Activate"), false)) {
@@ -0,0 +1,255 @@
+/*
+SPDX-FileCopyrightText: 2026 agent <agent@local>
+
+SPDX-License-Identifier: GPL-2.0-or-later
+*/
+#include "log_sink.h"
+
+#include <QString>
+#include <cerrno>
+#include <cstdio>
+#include <csignal>
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+
+namespace theseus_ship
+{
+
+std::atomic<log_sink*> log_sink::instance{nullptr};
+std::atomic<int> log_sink::producers{0};
+
+namespace
+{
+
+void write_all(int fd, char const* data, size_t size)
+{
+    while (size > 0) {
+        auto const count = ::write(fd, data, size);
+        if (count < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return;
+        }
+        data += count;
+        size -= count;
+    }
+}
+
+}
+
+log_sink::log_sink(std::string path, size_t max_size)
+    : path{std::move(path)}
+    , max_size{max_size > 0 ? max_size : default_max_size}
+    , slots{std::make_unique<std::array<slot, capacity>>()}
+{
+    static_assert((capacity & (capacity - 1)) == 0, "Capacity must be a power of two.");
+
+    for (size_t i = 0; i < capacity; i++) {
+        (*slots)[i].sequence.store(i, std::memory_order_relaxed);
+    }
+}
+
+log_sink::~log_sink()
+{
+    if (!thread.joinable()) {
+        return;
+    }
+
+    qInstallMessageHandler(previous_handler);
+    instance = nullptr;
+
+    // Producers that got hold of the instance before it was reset may still push. Wait for them,
+    // so nothing is pushed after the writer thread has drained the queue for the last time.
+    while (producers.load() > 0) {
+        std::this_thread::yield();
+    }
+
+    stopping = true;
+    pending.fetch_add(1, std::memory_order_release);
+    pending.notify_one();
+    thread.join();
+}
+
+bool log_sink::start()
+{
+    if (!open_file()) {
+        return false;
+    }
+
+    thread = std::thread([this] { run(); });
+    instance = this;
+    previous_handler = qInstallMessageHandler(&log_sink::handle_message);
+    return true;
+}
+
+void log_sink::handle_message(QtMsgType type,
+                              QMessageLogContext const& context,
+                              QString const& msg)
+{
+    // Sequentially consistent with the reset of the instance in the destructor.
+    producers.fetch_add(1);
+
+    auto sink = instance.load();
+    if (!sink) {
+        producers.fetch_sub(1);
+        return;
+    }
+
+    auto message = qFormatLogMessage(type, context, msg).toLocal8Bit().toStdString();
+    message.push_back('\n');
+
+    if (type == QtFatalMsg) {
+        // The process aborts right after, so the queued messages and this one must reach the file
+        // synchronously.
+        sink->drain();
+        write_all(STDERR_FILENO, message.data(), message.size());
+        producers.fetch_sub(1);
+        return;
+    }
+
+    if (sink->push(std::move(message))) {
+        sink->pending.fetch_add(1, std::memory_order_release);
+        sink->pending.notify_one();
+    } else {
+        sink->dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    producers.fetch_sub(1);
+}
+
+bool log_sink::push(std::string&& message)
+{
+    auto pos = enqueue_pos.load(std::memory_order_relaxed);
+    slot* cell;
+
+    while (true) {
+        cell = &(*slots)[pos & (capacity - 1)];
+        auto const seq = cell->sequence.load(std::memory_order_acquire);
+        auto const diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+
+        if (diff == 0) {
+            if (enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            // Queue is full.
+            return false;
+        } else {
+            pos = enqueue_pos.load(std::memory_order_relaxed);
+        }
+    }
+
+    cell->message = std::move(message);
+    cell->sequence.store(pos + 1, std::memory_order_release);
+    return true;
+}
+
+bool log_sink::pop(std::string& message)
+{
+    auto pos = dequeue_pos.load(std::memory_order_relaxed);
+    slot* cell;
+
+    while (true) {
+        cell = &(*slots)[pos & (capacity - 1)];
+        auto const seq = cell->sequence.load(std::memory_order_acquire);
+        auto const diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+
+        if (diff == 0) {
+            if (dequeue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            // Queue is empty.
+            return false;
+        } else {
+            pos = dequeue_pos.load(std::memory_order_relaxed);
+        }
+    }
+
+    message = std::move(cell->message);
+    cell->sequence.store(pos + capacity, std::memory_order_release);
+    return true;
+}
+
+void log_sink::drain()
+{
+    // The queue allows multiple consumers, so this can run concurrently with the writer thread.
+    // Rotation is skipped since it is not synchronized with the writer thread.
+    std::string message;
+    while (pop(message)) {
+        write_all(fd, message.data(), message.size());
+    }
+}
+
+bool log_sink::open_file()
+{
+    auto const file_fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (file_fd < 0) {
+        return false;
+    }
+
+    // Stderr is inherited by launched processes, so it must stay open without close-on-exec.
+    if (dup2(file_fd, STDERR_FILENO) < 0) {
+        ::close(file_fd);
+        return false;
+    }
+
+    ::close(file_fd);
+    fd = STDERR_FILENO;
+    file_size = 0;
+    return true;
+}
+
+void log_sink::rotate()
+{
+    auto const rotated = path + ".1";
+    if (::rename(path.c_str(), rotated.c_str()) != 0) {
+        // Keep writing to the current file.
+        file_size = 0;
+        return;
+    }
+
+    open_file();
+}
+
+void log_sink::write_out(std::string const& message)
+{
+    write_all(fd, message.data(), message.size());
+    file_size += message.size();
+
+    if (file_size >= max_size) {
+        rotate();
+    }
+}
+
+void log_sink::run()
+{
+    // Signals are handled by the main thread.
+    sigset_t signals;
+    sigfillset(&signals);
+    pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
+    std::string message;
+
+    while (true) {
+        auto const seen = pending.load(std::memory_order_acquire);
+
+        while (pop(message)) {
+            write_out(message);
+        }
+
+        if (auto const count = dropped.exchange(0, std::memory_order_relaxed)) {
+            write_out("Log sink overflowed, dropped " + std::to_string(count) + " messages.\n");
+        }
+
+        if (stopping) {
+            break;
+        }
+
+        pending.wait(seen, std::memory_order_acquire);
+    }
+}
+
+}
@@ -0,0 +1,87 @@
+/*
+SPDX-FileCopyrightText: 2026 agent <agent@local>
+
+SPDX-License-Identifier: GPL-2.0-or-later
+*/
+#pragma once
+
+#include <QtGlobal>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+
+namespace theseus_ship
+{
+
+/**
+ * Writes Qt log messages to a file from a background thread.
+ *
+ * Messages are pushed into a bounded lock-free queue, so logging never blocks on file I/O. When
+ * the queue is full messages are dropped and the number of dropped messages is logged later on.
+ * Once the file exceeds the maximum size it is rotated to "<path>.1". Fatal messages are written
+ * synchronously after draining the queue, since the process aborts right after.
+ *
+ * Stderr is pointed at the log file as well to catch output that does not go through Qt, for
+ * example from launched processes.
+ */
+class log_sink
+{
+public:
+    static constexpr size_t default_max_size{64 * 1024 * 1024};
+
+    /**
+     * Rotates the file at @p max_size bytes. If it is 0 @c default_max_size is used.
+     */
+    log_sink(std::string path, size_t max_size);
+    ~log_sink();
+
+    /**
+     * Opens the log file. Returns false if that fails.
+     */
+    bool start();
+
+private:
+    static constexpr size_t capacity{4096};
+
+    struct slot {
+        std::atomic<size_t> sequence;
+        std::string message;
+    };
+
+    static void handle_message(QtMsgType type,
+                               QMessageLogContext const& context,
+                               QString const& msg);
+
+    bool push(std::string&& message);
+    bool pop(std::string& message);
+    void drain();
+    bool open_file();
+    void rotate();
+    void write_out(std::string const& message);
+    void run();
+
+    std::string path;
+    size_t max_size;
+    int fd{-1};
+    size_t file_size{0};
+
+    std::unique_ptr<std::array<slot, capacity>> slots;
+    alignas(64) std::atomic<size_t> enqueue_pos{0};
+    alignas(64) std::atomic<size_t> dequeue_pos{0};
+    alignas(64) std::atomic<uint32_t> pending{0};
+    std::atomic<uint64_t> dropped{0};
+    std::atomic<bool> stopping{false};
+
+    QtMessageHandler previous_handler{nullptr};
+    std::thread thread;
+
+    static std::atomic<log_sink*> instance;
+    // Number of threads currently inside handle_message.
+    static std::atomic<int> producers;
+};
+
+}
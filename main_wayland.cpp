@@ -5,12 +5,18 @@ SPDX-FileCopyrightText: 2023 Roman Gilg <subdiff@gmail.com>
 SPDX-License-Identifier: GPL-2.0-or-later
 */
 #include "main.h"
+#include "main_wayland.h"
+#include "fd_monitor.h"
+#include "log_sink.h"
+#include "presentation.h"
+#include "scheduling.h"
+#include "session_launcher.h"
+#include "shader_cache.h"
+#include "startup_trace.h"
+#include "tracing.h"
 
 #include <como/base/wayland/app_singleton.h>
-#include <como/base/wayland/xwl_platform.h>
-#include <como/desktop/kde/platform.h>
 #include <como/render/shortcuts_init.h>
-#include <como/script/platform.h>
 #include <como/win/shortcuts_init.h>
 
 #include <KShell>
@@ -20,36 +26,10 @@ SPDX-License-Identifier: GPL-2.0-or-later
 #include <QCommandLineParser>
 #include <QDebug>
 #include <QProcess>
+#include <QTimer>
+#include <future>
 #include <sys/resource.h>
 
-namespace theseus_ship
-{
-
-template<typename Base>
-struct input_mod {
-    using platform_t = como::input::wayland::platform<Base, input_mod>;
-    std::unique_ptr<como::input::dbus::device_manager<platform_t>> dbus;
-};
-
-struct space_mod {
-    std::unique_ptr<como::desktop::platform> desktop;
-};
-
-struct base_mod {
-    using platform_t = como::base::wayland::xwl_platform<base_mod>;
-    using render_t = como::render::wayland::xwl_platform<platform_t>;
-    using input_t = como::input::wayland::platform<platform_t, input_mod<platform_t>>;
-    using space_t = como::win::wayland::xwl_space<platform_t, space_mod>;
-
-    std::unique_ptr<render_t> render;
-    std::unique_ptr<input_t> input;
-    std::unique_ptr<space_t> space;
-    std::unique_ptr<como::xwl::xwayland<space_t>> xwayland;
-    std::unique_ptr<como::scripting::platform<space_t>> script;
-};
-
-}
-
 static rlimit originalNofileLimit = {
     .rlim_cur = 0,
     .rlim_max = 0,
@@ -114,10 +94,26 @@ int main(int argc, char* argv[])
 {
     using namespace theseus_ship;
 
-    // Redirect stderr output. This is useful as a workaround for missing logs in systemd journal
-    // when launching a full Plasma session.
+    // The trace origin is set here so that the phases are relative to process start-up.
+    startup_trace trace(qEnvironmentVariable("KWIN_STARTUP_TRACE"));
+
+    // Before the log sink starts its thread, so that only the main thread runs real-time.
+    // CAP_SYS_NICE is dropped later on, once the render platform has been started.
+    gain_real_time();
+
+    // Redirect log output. This is useful as a workaround for missing logs in systemd journal
+    // when launching a full Plasma session. The file is written from a background thread, so
+    // logging never blocks the compositor on disk I/O.
+    std::unique_ptr<log_sink> log;
     if (auto log_path = getenv("KWIN_LOG_PATH")) {
-        if (!freopen(log_path, "w", stderr)) {
+        // Maximum size of the log file in MiB before it is rotated. Zero means the default.
+        size_t max_size = 0;
+        if (auto env = getenv("KWIN_LOG_MAX_SIZE")) {
+            max_size = strtoul(env, nullptr, 10) * 1024 * 1024;
+        }
+
+        log = std::make_unique<log_sink>(log_path, max_size);
+        if (!log->start()) {
             std::cerr << "Failed to open '" << log_path << "' for writing stderr." << std::endl;
             return 1;
         }
@@ -145,6 +141,10 @@ int main(int argc, char* argv[])
             QStringLiteral("xwayland"),
             i18n("Start a rootless Xwayland server."),
         };
+        QCommandLineOption xwl_lazy = {
+            QStringLiteral("xwayland-lazy"),
+            i18n("Start a rootless Xwayland server after the first frame has been presented."),
+        };
         QCommandLineOption socket = {
             QStringList{QStringLiteral("s"), QStringLiteral("socket")},
             i18n("Name of the Wayland socket to listen on. If not set \"wayland-0\" is used."),
@@ -167,6 +167,11 @@ int main(int argc, char* argv[])
             i18n("Exit after the session application, which is started by KWin, closed."),
             QStringLiteral("/path/to/session"),
         };
+        QCommandLineOption startup_trace = {
+            QStringLiteral("startup-trace"),
+            i18n("Write the durations of the startup phases in Chrome trace format to a file."),
+            QStringLiteral("/path/to/trace.json"),
+        };
     } options;
 
     QCommandLineParser parser;
@@ -174,20 +179,21 @@ int main(int argc, char* argv[])
     KAboutData::applicationData().setupCommandLine(&parser);
 
     parser.addOption(options.xwl);
+    parser.addOption(options.xwl_lazy);
     parser.addOption(options.socket);
     parser.addOption(options.no_lockscreen);
     parser.addOption(options.no_global_shortcuts);
     parser.addOption(options.lockscreen);
     parser.addOption(options.exit_with_session);
+    parser.addOption(options.startup_trace);
     parser.addPositionalArgument(QStringLiteral("applications"),
                                  i18n("Applications to start once server is started"),
                                  QStringLiteral("[/path/to/application...]"));
 
-    como::base::wayland::app_singleton app(argc, argv);
+    auto app = trace.record("app_singleton",
+                            [&] { return como::base::wayland::app_singleton(argc, argv); });
 
-    if (!como::Perf::Ftrace::setEnabled(qEnvironmentVariableIsSet("KWIN_PERF_FTRACE"))) {
-        qWarning() << "Can't enable Ftrace via environment variable.";
-    }
+    tracing ftrace;
 
     KSignalHandler::self()->watchSignal(SIGTERM);
     KSignalHandler::self()->watchSignal(SIGINT);
@@ -202,6 +208,10 @@ int main(int argc, char* argv[])
     parser.process(*app.qapp);
     KAboutData::applicationData().processCommandLine(&parser);
 
+    if (parser.isSet(options.startup_trace)) {
+        trace.path = parser.value(options.startup_trace);
+    }
+
     auto flags = como::base::wayland::start_options::none;
     if (parser.isSet(options.lockscreen)) {
         flags = como::base::wayland::start_options::lock_screen;
@@ -217,122 +227,220 @@ int main(int argc, char* argv[])
     exit_process_t exit_process(*app.qapp);
 
     using base_t = como::base::wayland::xwl_platform<base_mod>;
-    base_t base({
-        .config = como::base::config(KConfig::OpenFlag::FullConfig, "kwinrc"),
-        .socket_name = parser.value(options.socket).toStdString(),
-        .flags = flags,
-        .mode = parser.isSet(options.xwl) ? como::base::operation_mode::xwayland
-                                          : como::base::operation_mode::wayland,
+    auto base = trace.record("base", [&] {
+        return base_t({
+            .config = como::base::config(KConfig::OpenFlag::FullConfig, "kwinrc"),
+            .socket_name = parser.value(options.socket).toStdString(),
+            .flags = flags,
+            .mode = parser.isSet(options.xwl) || parser.isSet(options.xwl_lazy)
+                ? como::base::operation_mode::xwayland
+                : como::base::operation_mode::wayland,
+        });
     });
 
-    base.mod.render = std::make_unique<base_t::render_t>(base);
+    // The render and input platforms and the device manager can't be created on worker threads.
+    // They parent QObjects and socket notifiers for the DRM, libinput and udev fds to objects on
+    // the main thread, the render platform makes its EGL context current on the creating thread
+    // and the device manager registers D-Bus objects that must share the thread of the input
+    // devices they expose. Reading the input configuration from disk is independent though and
+    // can overlap with the render platform creation, which usually blocks on DRM and EGL probing.
+    std::future<como::input::config> input_config;
+    if (qEnvironmentVariableIsSet("KWIN_PARALLEL_STARTUP")) {
+        input_config = std::async(std::launch::async, [] {
+            return como::input::config(KConfig::NoGlobals);
+        });
+    }
 
-    base.mod.input
-        = std::make_unique<base_t::input_t>(base, como::input::config(KConfig::NoGlobals));
-    base.mod.input->mod.dbus
-        = std::make_unique<como::input::dbus::device_manager<base_t::input_t>>(*base.mod.input);
+    auto const shader_cache_variables = setup_shader_cache();
 
-    base.mod.space = std::make_unique<base_t::space_t>(*base.mod.render, *base.mod.input);
-    base.mod.space->mod.desktop
-        = std::make_unique<como::desktop::kde::platform<base_t::space_t>>(*base.mod.space);
-    como::win::init_shortcuts(*base.mod.space);
-    como::render::init_shortcuts(*base.mod.render);
-    base.mod.script = std::make_unique<como::scripting::platform<base_t::space_t>>(*base.mod.space);
+    trace.record("render", [&] { base.mod.render = std::make_unique<base_t::render_t>(base); });
+    connect_frame_presented(*base.mod.render, &ftrace, [] { tracing::frame_presented(); });
 
-    como::base::wayland::platform_start(base);
+    trace.record("input", [&] {
+        base.mod.input = std::make_unique<base_t::input_t>(
+            base,
+            input_config.valid() ? input_config.get() : como::input::config(KConfig::NoGlobals));
+    });
+    trace.record("input_dbus", [&] {
+        base.mod.input->mod.dbus = std::make_unique<
+            como::input::dbus::device_manager<base_t::input_t>>(*base.mod.input);
+    });
+
+    trace.record("space", [&] {
+        base.mod.space = std::make_unique<base_t::space_t>(*base.mod.render, *base.mod.input);
+    });
+    trace.record("desktop", [&] {
+        base.mod.space->mod.desktop
+            = std::make_unique<como::desktop::kde::platform<base_t::space_t>>(*base.mod.space);
+    });
+    trace.record("shortcuts", [&] {
+        como::win::init_shortcuts(*base.mod.space);
+        como::render::init_shortcuts(*base.mod.render);
+    });
+
+    auto create_scripting = [&] {
+        auto const trace_id
+            = tracing::begin(tracing::category::scripting, QStringLiteral("platform"));
+        trace.record("scripting", [&] {
+            base.mod.script
+                = std::make_unique<como::scripting::platform<base_t::space_t>>(*base.mod.space);
+        });
+        tracing::end(tracing::category::scripting, QStringLiteral("platform"), trace_id);
+    };
+
+    // Phases run after the first frame has been presented are recorded after the event loop has
+    // been entered. The trace is written only once they are done.
+    bool deferred_phases = false;
+
+    if (qEnvironmentVariableIsSet("KWIN_DEFERRED_SCRIPTING")) {
+        deferred_phases = true;
+        // Scripts are loaded once the first frame has been presented. Windows existing at that
+        // point are not announced as added to the scripts, they find them in the window list.
+        on_first_present(*base.mod.render, app.qapp.get(), create_scripting);
+    } else {
+        create_scripting();
+    }
+
+    trace.record("platform_start", [&] { como::base::wayland::platform_start(base); });
+
+    // The render platform has created its EGL context now, which may have needed the capability
+    // for a high priority.
+    drop_nice_capability();
 
     base.process_environment = QProcessEnvironment::systemEnvironment();
+    for (auto const& variable : shader_cache_variables) {
+        base.process_environment.remove(variable);
+    }
 
     if (auto const& name = base.server->display->socket_name(); !name.empty()) {
         base.process_environment.insert(QStringLiteral("WAYLAND_DISPLAY"), name.c_str());
     }
 
-    base.server->init_screen_locker();
-
-    if (base.operation_mode == como::base::operation_mode::xwayland) {
-        try {
-            base.mod.xwayland
-                = std::make_unique<como::xwl::xwayland<base_t::space_t>>(*base.mod.space);
-        } catch (std::system_error const& exc) {
-            std::cerr << "FATAL ERROR creating Xwayland: " << exc.what() << std::endl;
-            exit(exc.code().value());
-        } catch (std::exception const& exc) {
-            std::cerr << "FATAL ERROR creating Xwayland: " << exc.what() << std::endl;
-            exit(1);
+    trace.record("screen_locker", [&] { base.server->init_screen_locker(); });
+
+    auto create_xwayland = [&] {
+        if (base.operation_mode == como::base::operation_mode::xwayland) {
+            try {
+                trace.record("xwayland", [&] {
+                    base.mod.xwayland
+                        = std::make_unique<como::xwl::xwayland<base_t::space_t>>(*base.mod.space);
+                });
+            } catch (std::system_error const& exc) {
+                std::cerr << "FATAL ERROR creating Xwayland: " << exc.what() << std::endl;
+                exit(exc.code().value());
+            } catch (std::exception const& exc) {
+                std::cerr << "FATAL ERROR creating Xwayland: " << exc.what() << std::endl;
+                exit(1);
+            }
+        }
+    };
+
+    auto start_session = [&] {
+        auto process_environment = base.process_environment;
+
+        // Enforce Wayland platform for started Qt apps. They otherwise for some reason prefer X11.
+        process_environment.insert(QStringLiteral("QT_QPA_PLATFORM"), QStringLiteral("wayland"));
+
+        // start session
+        if (parser.isSet(options.exit_with_session) /*&& !m_sessionArgument.isEmpty()*/) {
+            auto arguments = KShell::splitArgs(parser.value(options.exit_with_session));
+            if (!arguments.isEmpty()) {
+                QString program = arguments.takeFirst();
+                auto p = new QProcess(app.qapp.get());
+                p->setProcessChannelMode(QProcess::ForwardedErrorChannel);
+                p->setProcessEnvironment(process_environment);
+                QObject::connect(p,
+                                 qOverload<int, QProcess::ExitStatus>(&QProcess::finished),
+                                 app.qapp.get(),
+                                 [&exit_process, p](auto code, auto status) {
+                                     exit_process.process = {};
+                                     p->deleteLater();
+                                     if (status == QProcess::CrashExit) {
+                                         qWarning() << "Session process has crashed";
+                                         QCoreApplication::exit(-1);
+                                         return;
+                                     }
+
+                                     if (code) {
+                                         qWarning() << "Session process exited with code" << code;
+                                     }
+
+                                     QCoreApplication::exit(code);
+                                 });
+                p->setProgram(program);
+                p->setArguments(arguments);
+                p->start();
+                exit_process.process = p;
+            } else {
+                qWarning("Failed to launch the session process: %s is an invalid command",
+                         qPrintable(parser.value(options.exit_with_session)));
+            }
         }
-    }
 
-    auto process_environment = base.process_environment;
-
-    // Enforce Wayland platform for started Qt apps. They otherwise for some reason prefer X11.
-    process_environment.insert(QStringLiteral("QT_QPA_PLATFORM"), QStringLiteral("wayland"));
-
-    // start session
-    if (parser.isSet(options.exit_with_session) /*&& !m_sessionArgument.isEmpty()*/) {
-        auto arguments = KShell::splitArgs(parser.value(options.exit_with_session));
-        if (!arguments.isEmpty()) {
-            QString program = arguments.takeFirst();
-            auto p = new QProcess(app.qapp.get());
-            p->setProcessChannelMode(QProcess::ForwardedErrorChannel);
-            p->setProcessEnvironment(process_environment);
-            QObject::connect(p,
-                             qOverload<int, QProcess::ExitStatus>(&QProcess::finished),
-                             app.qapp.get(),
-                             [&exit_process, p](auto code, auto status) {
-                                 exit_process.process = {};
-                                 p->deleteLater();
-                                 if (status == QProcess::CrashExit) {
-                                     qWarning() << "Session process has crashed";
-                                     QCoreApplication::exit(-1);
-                                     return;
-                                 }
-
-                                 if (code) {
-                                     qWarning() << "Session process exited with code" << code;
-                                 }
-
-                                 QCoreApplication::exit(code);
-                             });
-            p->setProgram(program);
-            p->setArguments(arguments);
-            p->start();
-            exit_process.process = p;
-        } else {
-            qWarning("Failed to launch the session process: %s is an invalid command",
-                     qPrintable(parser.value(options.exit_with_session)));
+        // start the applications passed to us as command line arguments
+        if (auto apps = parser.positionalArguments(); !apps.isEmpty()) {
+            std::vector<launch_command> commands;
+            for (auto const& app_name : qAsConst(apps)) {
+                auto arguments = KShell::splitArgs(app_name);
+                if (arguments.isEmpty()) {
+                    qWarning("Failed to launch application: %s is an invalid command",
+                             qPrintable(app_name));
+                    continue;
+                }
+                QString program = arguments.takeFirst();
+                commands.push_back({program, arguments});
+            }
+            session_launcher::start_detached(
+                std::move(commands), process_environment, originalNofileLimit, app.qapp.get());
         }
+
+        // Need to create a launch environment job for Plasma components to catch up in a systemd
+        // boot. This implies we're running in a full Plasma session i.e. when we use the wrapper
+        // (that's there the service name comes from), but we can also do it in a plain setup
+        // without session. Registering the service names indicates that we're live and all env
+        // vars are exported.
+        auto env_sync_job = trace.record("launch_environment", [&] {
+            return new KUpdateLaunchEnvironmentJob(process_environment);
+        });
+        QObject::connect(
+            env_sync_job, &KUpdateLaunchEnvironmentJob::finished, app.qapp.get(), []() {
+                QDBusConnection::sessionBus().registerService(
+                    QStringLiteral("org.kde.KWinWrapper"));
+            });
+    };
+
+    if (parser.isSet(options.xwl_lazy)) {
+        deferred_phases = true;
+        // Xwayland is only started once the first frame has been presented, so it does not delay
+        // it. The session needs the X11 display in its environment and may launch X11 clients
+        // right away. It is therefore always started after Xwayland has been created.
+        on_first_present(*base.mod.render, app.qapp.get(), [&] {
+            create_xwayland();
+            start_session();
+        });
+    } else {
+        create_xwayland();
+        start_session();
     }
 
-    // start the applications passed to us as command line arguments
-    if (auto apps = parser.positionalArguments(); !apps.isEmpty()) {
-        for (auto const& app_name : qAsConst(apps)) {
-            auto arguments = KShell::splitArgs(app_name);
-            if (arguments.isEmpty()) {
-                qWarning("Failed to launch application: %s is an invalid command",
-                         qPrintable(app_name));
-                continue;
+    fd_monitor fds(qEnvironmentVariableIntValue("KWIN_FD_WARN_LIMIT"));
+
+    if (trace.enabled()) {
+        QTimer::singleShot(0, app.qapp.get(), [&trace, deferred_phases] {
+            trace.mark("event_loop");
+            if (!deferred_phases) {
+                trace.write();
             }
-            QString program = arguments.takeFirst();
-            // note: this will kill the started process when we exit
-            // this is going to happen anyway as we are the wayland and X server the app connects to
-            auto p = new QProcess(app.qapp.get());
-            p->setProcessChannelMode(QProcess::ForwardedErrorChannel);
-            p->setProcessEnvironment(process_environment);
-            p->setProgram(program);
-            p->setArguments(arguments);
-            p->startDetached();
-            p->deleteLater();
+        });
+        if (deferred_phases) {
+            // Connected after the deferred phases, so it is called once they have been recorded.
+            on_first_present(*base.mod.render, app.qapp.get(), [&trace] { trace.write(); });
         }
     }
 
-    // Need to create a launch environment job for Plasma components to catch up in a systemd boot.
-    // This implies we're running in a full Plasma session i.e. when we use the wrapper (that's
-    // there the service name comes from), but we can also do it in a plain setup without session.
-    // Registering the service names indicates that we're live and all env vars are exported.
-    auto env_sync_job = new KUpdateLaunchEnvironmentJob(process_environment);
-    QObject::connect(env_sync_job, &KUpdateLaunchEnvironmentJob::finished, app.qapp.get(), []() {
-        QDBusConnection::sessionBus().registerService(QStringLiteral("org.kde.KWinWrapper"));
-    });
+    auto const ret = app.qapp->exec();
 
-    return app.qapp->exec();
+    // Includes phases that completed only after the trace was written, if any.
+    trace.write();
+    return ret;
 }
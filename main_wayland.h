@@ -0,0 +1,38 @@
+/*
+SPDX-FileCopyrightText: 2023 Roman Gilg <subdiff@gmail.com>
+
+SPDX-License-Identifier: GPL-2.0-or-later
+*/
+#pragma once
+
+#include <como/base/wayland/xwl_platform.h>
+#include <como/desktop/kde/platform.h>
+#include <como/script/platform.h>
+
+namespace theseus_ship
+{
+
+template<typename Base>
+struct input_mod {
+    using platform_t = como::input::wayland::platform<Base, input_mod>;
+    std::unique_ptr<como::input::dbus::device_manager<platform_t>> dbus;
+};
+
+struct space_mod {
+    std::unique_ptr<como::desktop::platform> desktop;
+};
+
+struct base_mod {
+    using platform_t = como::base::wayland::xwl_platform<base_mod>;
+    using render_t = como::render::wayland::xwl_platform<platform_t>;
+    using input_t = como::input::wayland::platform<platform_t, input_mod<platform_t>>;
+    using space_t = como::win::wayland::xwl_space<platform_t, space_mod>;
+
+    std::unique_ptr<render_t> render;
+    std::unique_ptr<input_t> input;
+    std::unique_ptr<space_t> space;
+    std::unique_ptr<como::xwl::xwayland<space_t>> xwayland;
+    std::unique_ptr<como::scripting::platform<space_t>> script;
+};
+
+}
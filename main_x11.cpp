@@ -7,16 +7,13 @@
     SPDX-License-Identifier: GPL-2.0-or-later
 */
 #include "main.h"
+#include "main_x11.h"
+#include "presentation.h"
+#include "tracing.h"
 
-#include <como/base/seat/backend/logind/session.h>
 #include <como/base/x11/app_singleton.h>
-#include <como/base/x11/platform.h>
 #include <como/base/x11/platform_helpers.h>
-#include <como/debug/perf/ftrace.h>
-#include <como/desktop/kde/platform.h>
-#include <como/render/backend/x11/platform.h>
 #include <como/render/shortcuts_init.h>
-#include <como/script/platform.h>
 #include <como/win/shortcuts_init.h>
 
 #include <KCrash>
@@ -25,13 +22,25 @@
 #include <QDBusMessage>
 #include <QDBusPendingCall>
 #include <QFile>
-#include <iostream>
+#include <xcb/composite.h>
+#include <xcb/damage.h>
+#include <xcb/glx.h>
+#include <xcb/randr.h>
+#include <xcb/render.h>
+#include <xcb/shape.h>
+#include <xcb/sync.h>
+#include <xcb/xcb.h>
+#include <xcb/xfixes.h>
+#include <xcb/xkb.h>
 
 namespace
 {
 
 int crash_count = 0;
 
+// Resolved at startup since the crash handler should not allocate.
+QByteArray app_path;
+
 void notify_ksplash()
 {
     // Tell KSplash that KWin has started
@@ -44,42 +53,62 @@ void notify_ksplash()
     QDBusConnection::sessionBus().asyncCall(ksplash_progress_message);
 }
 
+// Sends the extension queries in one batch without waiting. Later lookups of the extension data
+// are then answered from the connection's cache instead of each requiring a round trip.
+void prefetch_extensions(xcb_connection_t* connection)
+{
+    for (auto ext : {&xcb_composite_id,
+                     &xcb_damage_id,
+                     &xcb_glx_id,
+                     &xcb_randr_id,
+                     &xcb_render_id,
+                     &xcb_shape_id,
+                     &xcb_sync_id,
+                     &xcb_xfixes_id,
+                     &xcb_xkb_id}) {
+        xcb_prefetch_extension_data(connection, ext);
+    }
+    xcb_flush(connection);
+}
+
 void crash_handler(int signal)
 {
     crash_count++;
 
     fprintf(
         stderr, "crash_handler() called with signal %d; recent crashes: %d\n", signal, crash_count);
-    char cmd[1024];
-    sprintf(cmd,
-            "%s --crashes %d &",
-            QFile::encodeName(QCoreApplication::applicationFilePath()).constData(),
-            crash_count);
-
-    sleep(1);
-    system(cmd);
-}
 
-}
+    char count[16];
+    snprintf(count, sizeof(count), "%d", crash_count);
 
-namespace theseus_ship
-{
+    auto const crashed_pid = getpid();
 
-struct space_mod {
-    std::unique_ptr<como::desktop::platform> desktop;
-};
+    // Exec directly instead of going through a shell. The new process is reparented once we die.
+    if (fork() == 0) {
+        // Only restart once the crashed process is gone. Before that the X server has not released
+        // its SubstructureRedirect selection and the new process would find it taken. Give up
+        // waiting after a few seconds, for example if DrKonqi stopped the crashed process. Only
+        // async-signal-safe functions are called here.
+        timespec const step{0, 10 * 1000 * 1000};
+        for (int i = 0; i < 500 && getppid() == crashed_pid; i++) {
+            nanosleep(&step, nullptr);
+        }
 
-struct base_mod {
-    using platform_t = como::base::x11::platform<base_mod>;
-    using render_t = como::render::x11::platform<platform_t>;
-    using input_t = como::input::x11::platform<platform_t>;
-    using space_t = como::win::x11::space<platform_t, space_mod>;
+        // Leave the X server time to handle the closed connection.
+        timespec const grace{0, 100 * 1000 * 1000};
+        nanosleep(&grace, nullptr);
 
-    std::unique_ptr<render_t> render;
-    std::unique_ptr<input_t> input;
-    std::unique_ptr<space_t> space;
-    std::unique_ptr<como::scripting::platform<space_t>> script;
-};
+        // Back off when crashing repeatedly. After a single crash restart right away to keep the
+        // glitch short. Window state survives in the window properties on the X server and is read
+        // back on startup.
+        if (crash_count > 1) {
+            sleep(1);
+        }
+
+        execl(app_path.constData(), app_path.constData(), "--crashes", count, nullptr);
+        _exit(1);
+    }
+}
 
 }
 
@@ -93,9 +122,7 @@ int main(int argc, char* argv[])
 
     como::base::x11::app_singleton app(argc, argv);
 
-    if (!como::Perf::Ftrace::setEnabled(qEnvironmentVariableIsSet("KWIN_PERF_FTRACE"))) {
-        qWarning() << "Can't enable Ftrace via environment variable.";
-    }
+    tracing ftrace;
 
     KSignalHandler::self()->watchSignal(SIGTERM);
     KSignalHandler::self()->watchSignal(SIGINT);
@@ -130,62 +157,53 @@ int main(int argc, char* argv[])
     using base_t = como::base::x11::platform<base_mod>;
     base_t base(como::base::config(KConfig::OpenFlag::FullConfig, "kwinrc"));
 
+    prefetch_extensions(base.x11_data.connection);
+
+    app_path = QFile::encodeName(QCoreApplication::applicationFilePath());
     KCrash::setEmergencySaveFunction(crash_handler);
     como::base::x11::platform_init_crash_count(base, crash_count);
 
-    auto handle_ownership_claimed = [&base] {
+    auto handle_ownership_claimed = [&app, &base] {
         base.options
             = como::base::create_options(como::base::operation_mode::x11, base.config.main);
 
-        // Check  whether another windowmanager is running
-        const uint32_t maskValues[] = {XCB_EVENT_MASK_SUBSTRUCTURE_REDIRECT};
-        como::unique_cptr<xcb_generic_error_t> redirectCheck(
-            xcb_request_check(base.x11_data.connection,
-                              xcb_change_window_attributes_checked(base.x11_data.connection,
-                                                                   base.x11_data.root_window,
-                                                                   XCB_CW_EVENT_MASK,
-                                                                   maskValues)));
-        if (redirectCheck) {
+        // Check whether another window manager is running before any platform is created, so
+        // nothing touches the X server's windows in that case.
+        if (!redirect_root_window(base)) {
             fputs(i18n("kwin: another window manager is running (try using --replace)\n")
                       .toLocal8Bit()
                       .constData(),
                   stderr);
             // If this is a crash-restart, DrKonqi may have stopped the process w/o killing the
-            // connection.
+            // connection. The crash handler stops waiting for it to be gone in that case.
             if (base.crash_count == 0) {
                 ::exit(1);
             }
         }
 
-        base.session = std::make_unique<como::base::seat::backend::logind::session>();
-        base.mod.render = std::make_unique<como::render::backend::x11::platform<base_t>>(base);
-        base.mod.input = std::make_unique<como::input::x11::platform<base_t>>(base);
-
-        base.update_outputs();
-        auto render
-            = static_cast<como::render::backend::x11::platform<base_t>*>(base.mod.render.get());
-        try {
-            render->init();
-        } catch (std::exception const&) {
-            std::cerr << "FATAL ERROR: backend failed to initialize, exiting now" << std::endl;
-            ::exit(1);
-        }
-
-        try {
-            base.mod.space = std::make_unique<base_t::space_t>(*base.mod.render, *base.mod.input);
-        } catch (std::exception& ex) {
-            qCCritical(KWIN_CORE) << "Abort since space creation fails with:" << ex.what();
-            exit(1);
-        }
-
-        base.mod.space->mod.desktop
-            = std::make_unique<como::desktop::kde::platform<base_t::space_t>>(*base.mod.space);
+        auto render = create_platforms(base);
         como::win::init_shortcuts(*base.mod.space);
         como::render::init_shortcuts(*base.mod.render);
 
-        base.mod.script
-            = std::make_unique<como::scripting::platform<base_t::space_t>>(*base.mod.space);
-        render->start(*base.mod.space);
+        auto create_scripting = [&base] {
+            auto const trace_id
+                = tracing::begin(tracing::category::scripting, QStringLiteral("platform"));
+            base.mod.script
+                = std::make_unique<como::scripting::platform<base_t::space_t>>(*base.mod.space);
+            tracing::end(tracing::category::scripting, QStringLiteral("platform"), trace_id);
+        };
+
+        if (qEnvironmentVariableIsSet("KWIN_DEFERRED_SCRIPTING")) {
+            // Scripts are loaded once the first frame has been presented. Windows managed at that
+            // point are not announced as added to the scripts, they find them in the window list.
+            render->start(*base.mod.space);
+            on_first_present(*render, app.qapp.get(), create_scripting);
+        } else {
+            create_scripting();
+            render->start(*base.mod.space);
+        }
+
+        connect_frame_presented(*render, app.qapp.get(), [] { tracing::frame_presented(); });
 
         // Trigger possible errors, there's still a chance to abort.
         como::base::x11::xcb::sync(base.x11_data.connection);
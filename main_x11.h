@@ -0,0 +1,87 @@
+/*
+SPDX-FileCopyrightText: 2021 Roman Gilg <subdiff@gmail.com>
+
+SPDX-License-Identifier: GPL-2.0-or-later
+*/
+#pragma once
+
+#include <como/base/seat/backend/logind/session.h>
+#include <como/base/x11/platform.h>
+#include <como/desktop/kde/platform.h>
+#include <como/render/backend/x11/platform.h>
+#include <como/script/platform.h>
+
+#include <iostream>
+#include <xcb/xcb.h>
+
+namespace theseus_ship
+{
+
+struct space_mod {
+    std::unique_ptr<como::desktop::platform> desktop;
+};
+
+struct base_mod {
+    using platform_t = como::base::x11::platform<base_mod>;
+    using render_t = como::render::x11::platform<platform_t>;
+    using input_t = como::input::x11::platform<platform_t>;
+    using space_t = como::win::x11::space<platform_t, space_mod>;
+
+    std::unique_ptr<render_t> render;
+    std::unique_ptr<input_t> input;
+    std::unique_ptr<space_t> space;
+    std::unique_ptr<como::scripting::platform<space_t>> script;
+};
+
+/**
+ * Selects SubstructureRedirect on the root window. Returns false if another window manager holds
+ * it already.
+ */
+template<typename Base>
+bool redirect_root_window(Base& base)
+{
+    uint32_t const mask_values[] = {XCB_EVENT_MASK_SUBSTRUCTURE_REDIRECT};
+    como::unique_cptr<xcb_generic_error_t> error(
+        xcb_request_check(base.x11_data.connection,
+                          xcb_change_window_attributes_checked(base.x11_data.connection,
+                                                               base.x11_data.root_window,
+                                                               XCB_CW_EVENT_MASK,
+                                                               mask_values)));
+    return !error;
+}
+
+/**
+ * Creates the session, render, input and space platforms after the window manager selection has
+ * been claimed and the root window redirected. Exits when the render backend or the space fail to
+ * initialize. Returns the render platform, which still needs to be started.
+ */
+template<typename Base>
+auto create_platforms(Base& base)
+{
+    base.session = std::make_unique<como::base::seat::backend::logind::session>();
+    base.mod.render = std::make_unique<como::render::backend::x11::platform<Base>>(base);
+    base.mod.input = std::make_unique<como::input::x11::platform<Base>>(base);
+
+    base.update_outputs();
+    auto render = static_cast<como::render::backend::x11::platform<Base>*>(base.mod.render.get());
+    try {
+        render->init();
+    } catch (std::exception const&) {
+        std::cerr << "FATAL ERROR: backend failed to initialize, exiting now" << std::endl;
+        ::exit(1);
+    }
+
+    try {
+        base.mod.space
+            = std::make_unique<typename Base::space_t>(*base.mod.render, *base.mod.input);
+    } catch (std::exception& ex) {
+        qCCritical(KWIN_CORE) << "Abort since space creation fails with:" << ex.what();
+        ::exit(1);
+    }
+
+    base.mod.space->mod.desktop
+        = std::make_unique<como::desktop::kde::platform<typename Base::space_t>>(*base.mod.space);
+    return render;
+}
+
+}
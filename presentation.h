@@ -0,0 +1,63 @@
+/*
+SPDX-FileCopyrightText: 2026 agent <agent@local>
+
+SPDX-License-Identifier: GPL-2.0-or-later
+*/
+#pragma once
+
+#include <QObject>
+#include <QTimer>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <type_traits>
+
+namespace theseus_ship
+{
+
+/**
+ * Calls @p callback every time the compositor completed the buffer swap of a frame, that is
+ * when the frame has been handed to the display.
+ */
+template<typename Render>
+QMetaObject::Connection connect_frame_presented(Render& render,
+                                                QObject* context,
+                                                std::function<void()> callback)
+{
+    auto qobject = render.compositor->qobject.get();
+    using qobject_t = std::remove_pointer_t<decltype(qobject)>;
+    return QObject::connect(qobject, &qobject_t::bufferSwapCompleted, context, std::move(callback));
+}
+
+/**
+ * Calls @p callback once after the compositor presented its first frame.
+ *
+ * If no frame is presented within @p timeout, for example because no output is enabled or
+ * compositing is disabled, @p callback is called then.
+ */
+template<typename Render>
+void on_first_present(Render& render,
+                      QObject* context,
+                      std::function<void()> callback,
+                      std::chrono::milliseconds timeout = std::chrono::seconds(3))
+{
+    struct state_t {
+        QMetaObject::Connection connection;
+        bool done{false};
+    };
+    auto state = std::make_shared<state_t>();
+
+    auto fire = [state, callback = std::move(callback)] {
+        if (state->done) {
+            return;
+        }
+        state->done = true;
+        QObject::disconnect(state->connection);
+        callback();
+    };
+
+    state->connection = connect_frame_presented(render, context, fire);
+    QTimer::singleShot(timeout, context, fire);
+}
+
+}
@@ -0,0 +1,107 @@
+/*
+SPDX-FileCopyrightText: 2026 agent <agent@local>
+
+SPDX-License-Identifier: GPL-2.0-or-later
+*/
+#pragma once
+
+#include <config-theseus-ship.h>
+
+#include <como/base/logging.h>
+
+#include <QDebug>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <sched.h>
+#include <string_view>
+
+#if HAVE_LIBCAP
+#include <sys/capability.h>
+#endif
+
+namespace theseus_ship
+{
+
+/**
+ * Drops CAP_SYS_NICE from all capability sets.
+ *
+ * Call it once the render platform has been started, since creating a high-priority EGL context
+ * may need the capability.
+ */
+inline void drop_nice_capability()
+{
+#if HAVE_LIBCAP
+    auto caps = cap_get_proc();
+    if (!caps) {
+        return;
+    }
+
+    cap_value_t const nice_cap[] = {CAP_SYS_NICE};
+    cap_set_flag(caps, CAP_EFFECTIVE, 1, nice_cap, CAP_CLEAR);
+    cap_set_flag(caps, CAP_PERMITTED, 1, nice_cap, CAP_CLEAR);
+    cap_set_flag(caps, CAP_INHERITABLE, 1, nice_cap, CAP_CLEAR);
+
+    if (cap_set_proc(caps) != 0) {
+        std::cerr << "Failed to drop CAP_SYS_NICE: " << strerror(errno) << std::endl;
+    }
+    cap_free(caps);
+#endif
+}
+
+/**
+ * Gives the calling thread a real-time scheduling policy.
+ *
+ * Must be called from the main thread, which drives input dispatch and page flips, before any
+ * other thread is started. Threads started afterwards, like the one of the log sink, get the
+ * normal policy. The policy is chosen through the KWIN_SCHED_POLICY environment variable
+ * with the values "rr" (default), "fifo" or "none". The priority can be set with
+ * KWIN_SCHED_PRIORITY.
+ *
+ * SCHED_RESET_ON_FORK is set so threads and child processes, in particular the session and the
+ * applications we launch, start with the normal policy again.
+ *
+ * Without CAP_SYS_NICE, which is the common case for an installation without setcap, this fails
+ * and is only logged at debug level.
+ */
+inline void gain_real_time()
+{
+    int policy = SCHED_RR;
+
+    if (auto const env = getenv("KWIN_SCHED_POLICY")) {
+        std::string_view const value{env};
+        if (value == "fifo") {
+            policy = SCHED_FIFO;
+        } else if (value == "none") {
+            policy = SCHED_OTHER;
+        } else if (value != "rr") {
+            std::cerr << "Unknown scheduling policy '" << value << "', using round-robin."
+                      << std::endl;
+        }
+    }
+
+    if (policy != SCHED_OTHER) {
+        sched_param param;
+        param.sched_priority = sched_get_priority_min(policy);
+
+        if (auto const env = getenv("KWIN_SCHED_PRIORITY")) {
+            auto const prio = atoi(env);
+            if (prio >= sched_get_priority_min(policy) && prio <= sched_get_priority_max(policy)) {
+                param.sched_priority = prio;
+            }
+        }
+
+        if (sched_setscheduler(0, policy | SCHED_RESET_ON_FORK, &param) != 0) {
+            auto const error = errno;
+            if (error == EPERM) {
+                qCDebug(KWIN_CORE) << "Not gaining real-time scheduling:" << strerror(error);
+            } else {
+                std::cerr << "Failed to gain real-time scheduling: " << strerror(error)
+                          << std::endl;
+            }
+        }
+    }
+}
+
+}
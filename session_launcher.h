@@ -0,0 +1,211 @@
+/*
+SPDX-FileCopyrightText: 2026 agent <agent@local>
+
+SPDX-License-Identifier: GPL-2.0-or-later
+*/
+#pragma once
+
+#include <QDebug>
+#include <QFile>
+#include <QMetaObject>
+#include <QObject>
+#include <QPointer>
+#include <QProcessEnvironment>
+#include <QSocketNotifier>
+#include <QStandardPaths>
+#include <QStringList>
+#include <QThreadPool>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <spawn.h>
+#include <string>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace theseus_ship
+{
+
+struct launch_command {
+    QString program;
+    QStringList arguments;
+};
+
+/**
+ * Starts processes detached from the compositor without going through QProcess.
+ *
+ * All commands are started in one batch with posix_spawn on a worker thread. Each one runs in
+ * a session of its own. The children are reaped through pidfds in the thread of the context
+ * object, so no thread blocks on them.
+ */
+class session_launcher
+{
+public:
+    /**
+     * Starts @p commands with environment @p env. The children get @p nofile_limit as their
+     * RLIMIT_NOFILE, unless it is zero. Failures are logged asynchronously in the thread of
+     * @p context.
+     */
+    static void start_detached(std::vector<launch_command> commands,
+                               QProcessEnvironment const& env,
+                               rlimit const& nofile_limit,
+                               QObject* context)
+    {
+        if (commands.empty()) {
+            return;
+        }
+
+        QThreadPool::globalInstance()->start([commands = std::move(commands),
+                                              env,
+                                              nofile_limit,
+                                              context = QPointer<QObject>(context)] {
+            auto results = spawn(commands, env, nofile_limit);
+            QMetaObject::invokeMethod(
+                context,
+                [context, results = std::move(results)] {
+                    for (auto const& result : results) {
+                        if (result.error) {
+                            qWarning("Failed to launch application %s: %s",
+                                     qPrintable(result.program),
+                                     strerror(result.error));
+                            continue;
+                        }
+                        reap(result.pid, context);
+                    }
+                },
+                Qt::QueuedConnection);
+        });
+    }
+
+private:
+    struct spawn_result {
+        QString program;
+        pid_t pid{-1};
+        int error{0};
+    };
+
+    static std::vector<spawn_result> spawn(std::vector<launch_command> const& commands,
+                                           QProcessEnvironment const& env,
+                                           rlimit const& nofile_limit)
+    {
+        auto const search_paths = env.value(QStringLiteral("PATH")).split(
+            QLatin1Char(':'), Qt::SkipEmptyParts);
+
+        auto env_strings = to_strings(env.toStringList());
+        auto envp = to_pointers(env_strings);
+
+        posix_spawnattr_t attr;
+        posix_spawnattr_init(&attr);
+
+        // The compositor ignores SIGPIPE and blocks the user signals. Children should not inherit
+        // that.
+        sigset_t default_signals;
+        sigemptyset(&default_signals);
+        sigaddset(&default_signals, SIGPIPE);
+        sigaddset(&default_signals, SIGUSR1);
+        sigaddset(&default_signals, SIGUSR2);
+        posix_spawnattr_setsigdefault(&attr, &default_signals);
+
+        sigset_t empty_mask;
+        sigemptyset(&empty_mask);
+        posix_spawnattr_setsigmask(&attr, &empty_mask);
+
+        posix_spawnattr_setflags(&attr,
+                                 POSIX_SPAWN_SETSID | POSIX_SPAWN_SETSIGDEF
+                                     | POSIX_SPAWN_SETSIGMASK);
+
+        std::vector<spawn_result> results;
+        results.reserve(commands.size());
+
+        for (auto const& cmd : commands) {
+            auto const path = resolve(cmd.program, search_paths);
+            if (path.isEmpty()) {
+                results.push_back({cmd.program, -1, ENOENT});
+                continue;
+            }
+
+            auto argv_strings = to_strings(QStringList{cmd.program} + cmd.arguments);
+            auto argv = to_pointers(argv_strings);
+
+            pid_t pid;
+            auto const error = posix_spawn(&pid,
+                                           QFile::encodeName(path).constData(),
+                                           nullptr,
+                                           &attr,
+                                           argv.data(),
+                                           envp.data());
+            if (error) {
+                results.push_back({cmd.program, -1, error});
+                continue;
+            }
+
+            // Unlike fork() posix_spawn does not run the fork handlers, which restore the limit
+            // the compositor was started with. Legacy apps using select() rely on it.
+            if (nofile_limit.rlim_cur > 0) {
+                prlimit(pid, RLIMIT_NOFILE, &nofile_limit, nullptr);
+            }
+
+            results.push_back({cmd.program, pid, 0});
+        }
+
+        posix_spawnattr_destroy(&attr);
+        return results;
+    }
+
+    static QString resolve(QString const& program, QStringList const& search_paths)
+    {
+        if (program.contains(QLatin1Char('/'))) {
+            return program;
+        }
+        return search_paths.isEmpty() ? QStandardPaths::findExecutable(program)
+                                      : QStandardPaths::findExecutable(program, search_paths);
+    }
+
+    static void reap(pid_t pid, QObject* context)
+    {
+        auto const fd = static_cast<int>(syscall(SYS_pidfd_open, pid, 0));
+        if (fd == -1) {
+            // Without pidfd support wait in a thread of its own.
+            std::thread([pid] {
+                while (waitpid(pid, nullptr, 0) == -1 && errno == EINTR) { }
+            }).detach();
+            return;
+        }
+
+        // The pidfd becomes readable once the child exited.
+        auto notifier = new QSocketNotifier(fd, QSocketNotifier::Read, context);
+        QObject::connect(notifier, &QSocketNotifier::activated, context, [notifier, fd, pid] {
+            waitpid(pid, nullptr, WNOHANG);
+            notifier->setEnabled(false);
+            notifier->deleteLater();
+            close(fd);
+        });
+    }
+
+    static std::vector<std::string> to_strings(QStringList const& list)
+    {
+        std::vector<std::string> strings;
+        strings.reserve(list.size());
+        for (auto const& entry : list) {
+            strings.push_back(QFile::encodeName(entry).toStdString());
+        }
+        return strings;
+    }
+
+    static std::vector<char*> to_pointers(std::vector<std::string>& strings)
+    {
+        std::vector<char*> pointers;
+        pointers.reserve(strings.size() + 1);
+        for (auto& str : strings) {
+            pointers.push_back(str.data());
+        }
+        pointers.push_back(nullptr);
+        return pointers;
+    }
+};
+
+}
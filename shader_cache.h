@@ -0,0 +1,77 @@
+/*
+SPDX-FileCopyrightText: 2026 agent <agent@local>
+
+SPDX-License-Identifier: GPL-2.0-or-later
+*/
+#pragma once
+
+#include <QDir>
+#include <QFile>
+#include <QStandardPaths>
+#include <QString>
+#include <QStringList>
+#include <QThreadPool>
+#include <sys/stat.h>
+
+namespace theseus_ship
+{
+
+/**
+ * Points the shader disk caches of the GL drivers to a directory of the compositor's own.
+ *
+ * Mesa and the NVIDIA driver share their shader cache with all applications and evict the least
+ * recently used entries once it is full. With a cache of its own the compositor finds its shaders
+ * after a restart even when games filled the shared one. The directory is keyed by the identity of
+ * the binary. Caches of previous builds are removed in the background.
+ *
+ * Nothing is changed if the user configured the cache location. Must be called before the render
+ * platform is created. Returns the environment variables that have been set. They should not be
+ * passed on to launched applications.
+ */
+inline QStringList setup_shader_cache()
+{
+    char const* const mesa_dir = "MESA_SHADER_CACHE_DIR";
+    char const* const nvidia_dir = "__GL_SHADER_DISK_CACHE_PATH";
+
+    if (qEnvironmentVariableIsSet(mesa_dir) || qEnvironmentVariableIsSet(nvidia_dir)) {
+        return {};
+    }
+
+    struct stat exe;
+    if (stat("/proc/self/exe", &exe) != 0) {
+        return {};
+    }
+
+    auto const root = QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation)
+        + QStringLiteral("/kwin/shaders");
+    auto const key = QStringLiteral("%1-%2-%3")
+                         .arg(exe.st_ino, 0, 16)
+                         .arg(exe.st_size, 0, 16)
+                         .arg(exe.st_mtim.tv_sec * 1000000000LL + exe.st_mtim.tv_nsec, 0, 16);
+    auto const path = root + QLatin1Char('/') + key;
+
+    if (!QDir(path).exists()) {
+        if (!QDir().mkpath(path)) {
+            return {};
+        }
+
+        // First start of this build.
+        QThreadPool::globalInstance()->start([root, key] {
+            QDir dir(root);
+            auto const builds = dir.entryList(QDir::Dirs | QDir::NoDotAndDotDot);
+            for (auto const& build : builds) {
+                if (build != key) {
+                    QDir(dir.filePath(build)).removeRecursively();
+                }
+            }
+        });
+    }
+
+    auto const encoded = QFile::encodeName(path);
+    qputenv(mesa_dir, encoded);
+    qputenv(nvidia_dir, encoded);
+
+    return {QString::fromLatin1(mesa_dir), QString::fromLatin1(nvidia_dir)};
+}
+
+}
@@ -0,0 +1,133 @@
+/*
+SPDX-FileCopyrightText: 2026 agent <agent@local>
+
+SPDX-License-Identifier: GPL-2.0-or-later
+*/
+#pragma once
+
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QString>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+namespace theseus_ship
+{
+
+/**
+ * Records the duration of startup phases and writes them out in the Chrome trace event format.
+ *
+ * This allows loading the result into chrome://tracing or Perfetto. Phases are always recorded
+ * since that is cheap, but only written out when a file path has been set.
+ */
+class startup_trace
+{
+public:
+    using clock = std::chrono::steady_clock;
+
+    struct phase {
+        std::string name;
+        clock::time_point start;
+        clock::time_point end;
+    };
+
+    explicit startup_trace(QString path = {})
+        : path{std::move(path)}
+        , origin{clock::now()}
+    {
+    }
+
+    bool enabled() const
+    {
+        return !path.isEmpty();
+    }
+
+    /**
+     * Times @p func as phase @p name and returns its result.
+     */
+    template<typename Func>
+    decltype(auto) record(std::string name, Func&& func)
+    {
+        struct guard {
+            ~guard()
+            {
+                trace.phases.push_back({std::move(name), start, clock::now()});
+            }
+            startup_trace& trace;
+            std::string name;
+            clock::time_point start;
+        } phase_guard{*this, std::move(name), clock::now()};
+
+        return func();
+    }
+
+    /**
+     * Marks a point in time without duration, for example when the event loop is entered.
+     */
+    void mark(std::string name)
+    {
+        auto const now = clock::now();
+        phases.push_back({std::move(name), now, now});
+    }
+
+    /**
+     * Writes the recorded phases to the file. Returns false on failure.
+     */
+    bool write() const
+    {
+        if (!enabled()) {
+            return true;
+        }
+
+        auto to_us = [this](clock::time_point point) {
+            return static_cast<qint64>(
+                std::chrono::duration_cast<std::chrono::microseconds>(point - origin).count());
+        };
+
+        QJsonArray events;
+        auto const pid = static_cast<qint64>(getpid());
+
+        for (auto const& phase : phases) {
+            QJsonObject event;
+            event.insert(QStringLiteral("name"), QString::fromStdString(phase.name));
+            event.insert(QStringLiteral("cat"), QStringLiteral("startup"));
+            event.insert(QStringLiteral("pid"), pid);
+            event.insert(QStringLiteral("tid"), pid);
+            event.insert(QStringLiteral("ts"), to_us(phase.start));
+
+            if (phase.start == phase.end) {
+                event.insert(QStringLiteral("ph"), QStringLiteral("i"));
+                event.insert(QStringLiteral("s"), QStringLiteral("p"));
+            } else {
+                event.insert(QStringLiteral("ph"), QStringLiteral("X"));
+                event.insert(QStringLiteral("dur"), to_us(phase.end) - to_us(phase.start));
+            }
+
+            events.append(event);
+        }
+
+        QJsonObject root;
+        root.insert(QStringLiteral("traceEvents"), events);
+        root.insert(QStringLiteral("displayTimeUnit"), QStringLiteral("ms"));
+
+        QFile file(path);
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+            std::cerr << "Failed to open startup trace file '" << path.toStdString()
+                      << "' for writing." << std::endl;
+            return false;
+        }
+
+        return file.write(QJsonDocument(root).toJson(QJsonDocument::Compact)) != -1;
+    }
+
+    QString path;
+    clock::time_point origin;
+    std::vector<phase> phases;
+};
+
+}
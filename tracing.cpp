@@ -0,0 +1,162 @@
+/*
+SPDX-FileCopyrightText: 2026 agent <agent@local>
+
+SPDX-License-Identifier: GPL-2.0-or-later
+*/
+#include "tracing.h"
+
+#include <como/debug/perf/ftrace.h>
+
+#include <QDBusConnection>
+#include <QDebug>
+#include <array>
+#include <utility>
+
+namespace theseus_ship
+{
+
+std::atomic<uint32_t> tracing::mask{0};
+std::atomic<uint64_t> tracing::frame{0};
+std::atomic<uint64_t> tracing::last_id{0};
+
+namespace
+{
+
+std::array<std::pair<tracing::category, QString>, 3> const category_names{{
+    {tracing::category::present, QStringLiteral("present")},
+    {tracing::category::scripting, QStringLiteral("scripting")},
+    {tracing::category::dbus, QStringLiteral("dbus")},
+}};
+
+uint32_t all_categories()
+{
+    uint32_t value = 0;
+    for (auto const& [cat, name] : category_names) {
+        value |= static_cast<uint32_t>(cat);
+    }
+    return value;
+}
+
+uint32_t parse_categories(QString const& list)
+{
+    uint32_t value = 0;
+    for (auto const& entry : list.split(QLatin1Char(','), Qt::SkipEmptyParts)) {
+        for (auto const& [cat, name] : category_names) {
+            if (entry.trimmed() == name) {
+                value |= static_cast<uint32_t>(cat);
+            }
+        }
+    }
+    return value;
+}
+
+QString category_name(tracing::category cat)
+{
+    for (auto const& [candidate, name] : category_names) {
+        if (candidate == cat) {
+            return name;
+        }
+    }
+    return {};
+}
+
+}
+
+tracing::tracing(QObject* parent)
+    : QObject(parent)
+{
+    if (qEnvironmentVariableIsSet("KWIN_PERF_FTRACE")) {
+        auto value = parse_categories(qEnvironmentVariable("KWIN_PERF_FTRACE"));
+        if (!set_mask(value ? value : all_categories())) {
+            qWarning() << "Can't enable Ftrace via environment variable.";
+        }
+    }
+
+    QDBusConnection::sessionBus().registerObject(
+        QStringLiteral("/Tracing"), this, QDBusConnection::ExportScriptableSlots);
+}
+
+tracing::~tracing()
+{
+    QDBusConnection::sessionBus().unregisterObject(QStringLiteral("/Tracing"));
+}
+
+void tracing::mark(category cat, QString const& name)
+{
+    if (!enabled(cat)) {
+        return;
+    }
+    como::Perf::Ftrace::mark(QStringLiteral("%1:%2 frame=%3")
+                                 .arg(category_name(cat), name)
+                                 .arg(frame.load(std::memory_order_relaxed)));
+}
+
+uint64_t tracing::begin(category cat, QString const& name)
+{
+    if (!enabled(cat)) {
+        return 0;
+    }
+    auto const id = ++last_id;
+    como::Perf::Ftrace::begin(QStringLiteral("%1:%2").arg(category_name(cat), name), id);
+    return id;
+}
+
+void tracing::end(category cat, QString const& name, uint64_t id)
+{
+    if (!id || !enabled(cat)) {
+        return;
+    }
+    como::Perf::Ftrace::end(QStringLiteral("%1:%2").arg(category_name(cat), name), id);
+}
+
+void tracing::frame_presented()
+{
+    frame.fetch_add(1, std::memory_order_relaxed);
+    mark(category::present, QStringLiteral("frame"));
+}
+
+QStringList tracing::categories() const
+{
+    QStringList names;
+    for (auto const& [cat, name] : category_names) {
+        names.append(name);
+    }
+    return names;
+}
+
+QStringList tracing::enabledCategories() const
+{
+    QStringList names;
+    for (auto const& [cat, name] : category_names) {
+        if (enabled(cat)) {
+            names.append(name);
+        }
+    }
+    return names;
+}
+
+bool tracing::setCategoryEnabled(QString const& name, bool enable)
+{
+    tracing::mark(category::dbus, QStringLiteral("setCategoryEnabled ") + name);
+
+    auto const value = parse_categories(name);
+    if (!value) {
+        return false;
+    }
+
+    auto const current = mask.load(std::memory_order_relaxed);
+    return set_mask(enable ? current | value : current & ~value);
+}
+
+bool tracing::set_mask(uint32_t value)
+{
+    if (!como::Perf::Ftrace::setEnabled(value != 0)) {
+        mask = 0;
+        return false;
+    }
+
+    mask = value;
+    return true;
+}
+
+}
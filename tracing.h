@@ -0,0 +1,78 @@
+/*
+SPDX-FileCopyrightText: 2026 agent <agent@local>
+
+SPDX-License-Identifier: GPL-2.0-or-later
+*/
+#pragma once
+
+#include <QObject>
+#include <QStringList>
+#include <atomic>
+#include <cstdint>
+
+namespace theseus_ship
+{
+
+/**
+ * Controls our ftrace markers per category at runtime.
+ *
+ * Categories can be set initially through the KWIN_PERF_FTRACE environment variable as a comma
+ * separated list. If the variable is set without a known category name all categories are enabled.
+ * At runtime they are toggled over D-Bus at /Tracing.
+ *
+ * The categories only filter the markers emitted here. Ftrace itself is a single switch of the
+ * compositor library and is enabled as long as at least one category is. The markers the library
+ * emits internally, for example while painting, are therefore not filtered by category.
+ *
+ * Presented frames are numbered, so markers of the other categories can be related to the frames
+ * around them.
+ */
+class tracing : public QObject
+{
+    Q_OBJECT
+    Q_CLASSINFO("D-Bus Interface", "org.kde.KWin.Tracing")
+
+public:
+    enum class category : uint32_t {
+        none = 0,
+        present = 1 << 0,
+        scripting = 1 << 1,
+        dbus = 1 << 2,
+    };
+
+    explicit tracing(QObject* parent = nullptr);
+    ~tracing() override;
+
+    static bool enabled(category cat)
+    {
+        return mask.load(std::memory_order_relaxed) & static_cast<uint32_t>(cat);
+    }
+
+    static void mark(category cat, QString const& name);
+
+    /**
+     * Emits a begin marker and returns the id to pass to the matching end() call.
+     */
+    static uint64_t begin(category cat, QString const& name);
+    static void end(category cat, QString const& name, uint64_t id);
+
+    /**
+     * To be called after each presented frame. Counts the frame and marks it in the present
+     * category.
+     */
+    static void frame_presented();
+
+public Q_SLOTS:
+    Q_SCRIPTABLE QStringList categories() const;
+    Q_SCRIPTABLE QStringList enabledCategories() const;
+    Q_SCRIPTABLE bool setCategoryEnabled(QString const& name, bool enable);
+
+private:
+    bool set_mask(uint32_t value);
+
+    static std::atomic<uint32_t> mask;
+    static std::atomic<uint64_t> frame;
+    static std::atomic<uint64_t> last_id;
+};
+
+}